@@ -0,0 +1,304 @@
+#ifndef ALPHA_BETA_ENGINE_HPP
+#define ALPHA_BETA_ENGINE_HPP
+
+#include "UCIEngine.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+// Fail hard negamax alpha-beta with iterative deepening. Each ply searches on
+// its own entry of the thread's stack, so memory stays the same at any depth
+// and nothing is allocated while searching. Scores, also those in the
+// transposition table, are from the side to move's point of view.
+//
+// The best line is collected in a triangular PV table, and the line of the
+// last iteration is searched first by the next, in an aspiration window
+// around its score.
+//
+// Engines decide what happens at the horizon.
+class AlphaBetaEngine : public UCIEngine
+{
+public:
+    void think() override
+    {
+        search_threads([&](SearchThread &t) { iterate(t); });
+
+        // End of function
+        thinking = false;
+    }
+
+protected:
+    // Score of the position at t.stack[ply] with no depth left, from the side
+    // to move's point of view. Moves are not generated yet.
+    virtual Score horizon(SearchThread &t, int ply, Score alpha, Score beta) = 0;
+
+    // Static evaluation for the side to move, lazily against its window
+    Score side_eval(SearchThread &t, const Board &pos, const MoveList &moves, int ply, Score alpha, Score beta)
+    {
+        if (pos.get_turn() == Color::White)
+            return lazy_eval(t, pos, moves, ply, alpha, beta);
+
+        return -lazy_eval(t, pos, moves, ply, -beta, -alpha);
+    }
+
+    Score negamax(SearchThread &t, Score alpha, Score beta, int depthleft, int ply)
+    {
+        t.nodes++;
+
+        t.stack[ply].pv_length = 0;
+
+        if (depthleft == 0 || ply == max_ply)
+            return horizon(t, ply, alpha, beta);
+
+        const Board &pos = t.stack[ply].board;
+        MoveList &moves = t.stack[ply].moves;
+
+        pos.get_moves(moves, t.z_list);
+
+        // Mates and draws first, a repeated position must not take the
+        // table's score
+        if (moves.is_checkmate || moves.is_stalemate || moves.size() == 0)
+            return (pos.get_turn() == Color::White) ? cached_eval(t, pos, moves, ply) : -cached_eval(t, pos, moves, ply);
+
+        // The root always searches, for its best move
+        const std::uint64_t key = pos.get_zobrist();
+        Score tt_score;
+        Move tt_move;
+        if (tt_cutoff(t, key, depthleft, ply, alpha, beta, tt_score, tt_move) && ply != 0)
+            return tt_score;
+
+        const bool on_pv = t.follow_pv && ply < t.pv_line_length;
+
+        // Null move. If passing still fails high at reduced depth, a real move
+        // would too.
+        if (
+                !on_pv && ply != 0 &&
+                null_move_allowed(t, pos, depthleft) &&
+                side_eval(t, pos, moves, ply, alpha, beta) >= beta
+           )
+        {
+            const int reduction = null_move_reduction(depthleft);
+
+            Board &child = t.stack[ply+1].board;
+            child = pos;
+            child.pass();
+
+            t.null_moves++;
+            t.follow_pv = false;
+
+            t.z_list.push_back(child.get_zobrist());
+            Score score = -negamax(t, -beta, -beta + 1, depthleft - 1 - reduction, ply + 1);
+            t.z_list.pop_back();
+
+            if (score >= beta && null_move_verify(pos))
+            {
+                // Same node without null moves, this regenerates moves
+                t.no_null = true;
+                score = negamax(t, beta - 1, beta, depthleft - reduction, ply);
+                t.no_null = false;
+            }
+
+            if (stopped())
+                return 0;
+
+            if (score >= beta)
+            {
+                t.null_cutoffs++;
+                return beta;
+            }
+        }
+
+        // The last iteration's move while still on its line, else the table
+        // move, first
+        const Move first = on_pv ? t.pv_line[ply] : tt_move;
+
+        score_moves(t, pos, moves, ply, first);
+
+        Board &child = t.stack[ply+1].board;
+        Move best;
+
+        for (std::uint8_t i = 0; i < moves.size(); i++)
+        {
+            pick_move(t, moves, ply, i);
+            const Move m = moves.at(i);
+
+            child = pos;
+            child.perform_move(m);
+
+            if (see_prune(t, pos, child, ply, depthleft, m, i))
+                continue;
+
+            t.follow_pv = on_pv && i == 0 && m.data == first.data;
+
+            t.z_list.push_back(child.get_zobrist());
+
+            // Late moves first get a reduced null window search, and the full
+            // one only if they beat alpha
+            const int reduction = late_move_reduction(t, pos, child, ply, depthleft, i);
+            Score score = alpha + 1;
+
+            if (reduction != 0)
+            {
+                t.reduced_moves++;
+                score = -negamax(t, -alpha - 1, -alpha, depthleft - 1 - reduction, ply + 1);
+
+                if (score > alpha)
+                    t.reduced_researches++;
+            }
+
+            if (score > alpha)
+                score = -negamax(t, -beta, -alpha, depthleft - 1, ply + 1);
+
+            t.z_list.pop_back();
+
+            if (stopped())
+                return 0;
+
+            if (score >= beta)
+            {
+                record_cutoff(t, pos, ply, depthleft, m, i);
+                tt.store(key, ply, m, beta, depthleft, Bound::Lower);
+                return beta; // fail hard beta-cutoff
+            }
+            if (score > alpha)
+            {
+                alpha = score;
+                best = m;
+                update_pv(t, ply, m);
+            }
+        }
+
+        tt.store(key, ply, best, alpha, depthleft, (best.data != 0) ? Bound::Exact : Bound::Upper);
+
+        // Nothing to report after failing low, the window is widened and
+        // searched again
+        if (ply == 0 && best.data != 0)
+            t.root_move = best;
+
+        return alpha;
+    }
+
+    // The line at ply is now m followed by the line at ply + 1
+    static void update_pv(SearchThread &t, int ply, Move m)
+    {
+        SearchPly &node = t.stack[ply];
+        const SearchPly &next = t.stack[ply+1];
+
+        node.pv[0] = m;
+        std::copy(next.pv.begin(), next.pv.begin() + next.pv_length, node.pv.begin() + 1);
+        node.pv_length = next.pv_length + 1;
+    }
+
+    // Root search in a window around the last iteration's score, widened on
+    // the failing side until the score falls inside. Full window when there
+    // is no usable previous score.
+    Score aspiration(SearchThread &t, int depth, Score previous, bool use_window)
+    {
+        if (!use_window || is_mate_score(previous))
+            return negamax(t, -infinite_score, infinite_score, depth, 0);
+
+        Score delta = aspiration_window;
+        Score alpha = std::max(previous - delta, -infinite_score);
+        Score beta = std::min(previous + delta, infinite_score);
+
+        t.aspiration_searches++;
+
+        while (1)
+        {
+            t.follow_pv = true;
+            const Score score = negamax(t, alpha, beta, depth, 0);
+
+            if (stopped())
+                return score;
+
+            delta *= 2;
+
+            if (score <= alpha && alpha > -infinite_score)
+            {
+                t.aspiration_fail_lows++;
+                alpha = std::max(score - delta, -infinite_score);
+            }
+            else if (score >= beta && beta < infinite_score)
+            {
+                t.aspiration_fail_highs++;
+                beta = std::min(score + delta, infinite_score);
+            }
+            else
+            {
+                return score;
+            }
+        }
+    }
+
+    // Iterative deepening on one thread. Odd helpers search one ply deeper
+    // than the main thread, so that the threads spread over two depths.
+    void iterate(SearchThread &t)
+    {
+        std::chrono::duration<double, std::milli> previous_ply(0);
+        std::chrono::duration<double, std::milli> last_ply(0);
+        int ply = 1;
+
+        std::uint64_t time_left = w_time;
+        std::uint64_t time_inc = w_inc;
+        if (t.board.get_turn() == Color::Black)
+        {
+            time_left = b_time;
+            time_inc = b_inc;
+        }
+
+        std::uint64_t max_time = std::min(time_inc + time_left/4, std::uint64_t{30000});
+        std::uint64_t exp_time = 0;
+
+        // Scores of the last two iterations. The horizon is reached by the
+        // same side every other ply, so scores swing between odd and even
+        // depths and the window is centred on the one two plies back.
+        std::array<Score, 2> previous = {0, 0};
+
+        while (
+                !stopped() && (
+                (depth_limit != 0) ?
+                (ply <= depth_limit) :
+                ((time_spent + exp_time < max_time) && (ply < max_ply)))
+              )
+        {
+            auto tp = std::chrono::high_resolution_clock::now();
+
+            const int depth = std::min(ply + (t.id & 1), max_ply - 1);
+
+            t.follow_pv = true;
+            const Score score = aspiration(t, depth, previous[ply & 1], ply > 2);
+            previous[ply & 1] = score;
+
+            if (stopped())
+                break;
+
+            std::chrono::duration<double> dur = std::chrono::high_resolution_clock::now() - tp;
+
+            const SearchPly &root = t.stack[0];
+            std::copy(root.pv.begin(), root.pv.begin() + root.pv_length, t.pv_line.begin());
+            t.pv_line_length = root.pv_length;
+
+            if (t.id == 0)
+            {
+                bestmove = t.root_move;
+                evaluation = score;
+                principal_variation.assign(root.pv.begin(), root.pv.begin() + root.pv_length);
+            }
+
+            // Stop once a forced mate is found
+            if (score >= mate_bound)
+            {
+                break;
+            }
+
+            ply++;
+            previous_ply = last_ply;
+            last_ply = dur;
+
+            exp_time = std::min(static_cast<double>(last_ply.count()/previous_ply.count()), double{30})*last_ply.count();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,433 @@
+#ifndef BATCH_MOVEGEN_HPP
+#define BATCH_MOVEGEN_HPP
+
+#include "Board.hpp"
+#include "KoggeStone.hpp"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Attack generation and legal move counting for many independent boards at
+// once. Boards are stored as struct-of-arrays, flipped so the side to move
+// always moves north, and processed 4 boards per instruction with AVX2 (1 at
+// a time without). Everything is done with set-wise shifts and occluded fills,
+// counting moves per direction so no piece loops are needed.
+
+namespace batch_lanes
+{
+    constexpr Bitboard rank_3 = 0x0000000000FF0000;
+
+    // One board per lane
+    struct Scalar
+    {
+        static constexpr std::size_t width = 1;
+
+        static Scalar load(const Bitboard *p) { return Scalar{*p}; }
+        static Scalar all(Bitboard b) { return Scalar{b}; }
+        void store(Bitboard *p) const { *p = v; }
+
+        Bitboard v;
+    };
+
+    inline Scalar operator&(Scalar a, Scalar b) { return Scalar{a.v & b.v}; }
+    inline Scalar operator|(Scalar a, Scalar b) { return Scalar{a.v | b.v}; }
+    inline Scalar operator^(Scalar a, Scalar b) { return Scalar{a.v ^ b.v}; }
+    inline Scalar operator~(Scalar a) { return Scalar{~a.v}; }
+    inline Scalar operator+(Scalar a, Scalar b) { return Scalar{a.v + b.v}; }
+
+    template <int S>
+    inline Scalar shift(Scalar a)
+    {
+        if constexpr (S > 0)
+            return Scalar{a.v << S};
+        else
+            return Scalar{a.v >> -S};
+    }
+
+    inline Scalar popcount(Scalar a) { return Scalar{bitboard_count(a.v)}; }
+
+    // All ones in lanes where a is non zero
+    inline Scalar nonzero(Scalar a) { return Scalar{(a.v != 0) ? ~Bitboard{0} : Bitboard{0}}; }
+
+    // All ones in lanes where a == b
+    inline Scalar equal(Scalar a, Scalar b) { return Scalar{(a.v == b.v) ? ~Bitboard{0} : Bitboard{0}}; }
+
+#ifdef __AVX2__
+    // Four boards per lane
+    struct Avx2
+    {
+        static constexpr std::size_t width = 4;
+
+        static Avx2 load(const Bitboard *p) { return Avx2{_mm256_load_si256(reinterpret_cast<const __m256i*>(p))}; }
+        static Avx2 all(Bitboard b) { return Avx2{_mm256_set1_epi64x(b)}; }
+        void store(Bitboard *p) const { _mm256_store_si256(reinterpret_cast<__m256i*>(p), v); }
+
+        __m256i v;
+    };
+
+    inline Avx2 operator&(Avx2 a, Avx2 b) { return Avx2{_mm256_and_si256(a.v, b.v)}; }
+    inline Avx2 operator|(Avx2 a, Avx2 b) { return Avx2{_mm256_or_si256(a.v, b.v)}; }
+    inline Avx2 operator^(Avx2 a, Avx2 b) { return Avx2{_mm256_xor_si256(a.v, b.v)}; }
+    inline Avx2 operator~(Avx2 a) { return Avx2{_mm256_xor_si256(a.v, _mm256_set1_epi64x(-1))}; }
+    inline Avx2 operator+(Avx2 a, Avx2 b) { return Avx2{_mm256_add_epi64(a.v, b.v)}; }
+
+    template <int S>
+    inline Avx2 shift(Avx2 a)
+    {
+        if constexpr (S > 0)
+            return Avx2{_mm256_slli_epi64(a.v, S)};
+        else
+            return Avx2{_mm256_srli_epi64(a.v, -S)};
+    }
+
+    // Nibble lookup popcount, summed per 64 bit lane
+    inline Avx2 popcount(Avx2 a)
+    {
+        const __m256i lookup = _mm256_setr_epi8(
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low_mask = _mm256_set1_epi8(0x0f);
+
+        const __m256i lo = _mm256_and_si256(a.v, low_mask);
+        const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(a.v, 4), low_mask);
+        const __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+
+        return Avx2{_mm256_sad_epu8(cnt, _mm256_setzero_si256())};
+    }
+
+    inline Avx2 nonzero(Avx2 a) { return ~Avx2{_mm256_cmpeq_epi64(a.v, _mm256_setzero_si256())}; }
+    inline Avx2 equal(Avx2 a, Avx2 b) { return Avx2{_mm256_cmpeq_epi64(a.v, b.v)}; }
+
+    using Native = Avx2;
+#else
+    using Native = Scalar;
+#endif
+
+    // Attacks from every square in gen in direction S, up to and including
+    // the first blocker. wrap masks out squares that wrapped around the board.
+    template <int S, typename V>
+    inline V slide(V gen, V empty, Bitboard wrap)
+    {
+        const V w = V::all(wrap);
+        V pro = empty & w;
+
+        gen = gen | (pro & shift<S>(gen));
+        pro = pro & shift<S>(pro);
+        gen = gen | (pro & shift<2*S>(gen));
+        pro = pro & shift<2*S>(pro);
+        gen = gen | (pro & shift<4*S>(gen));
+
+        return shift<S>(gen) & w;
+    }
+
+    template <int S, typename V>
+    inline V step(V gen, Bitboard wrap)
+    {
+        return shift<S>(gen) & V::all(wrap);
+    }
+
+    template <typename V>
+    inline V knight_attacks(V n)
+    {
+        return
+            step<17>(n, ~file_a) | step<15>(n, ~file_h) |
+            step<10>(n, ~(file_a | file_b)) | step<6>(n, ~(file_g | file_h)) |
+            step<-6>(n, ~(file_a | file_b)) | step<-10>(n, ~(file_g | file_h)) |
+            step<-15>(n, ~file_a) | step<-17>(n, ~file_h);
+    }
+
+    // Knight move count, one direction at a time so every target is counted
+    // once per knight reaching it
+    template <typename V>
+    inline V knight_count(V n, V target)
+    {
+        return
+            popcount(step<17>(n, ~file_a) & target) +
+            popcount(step<15>(n, ~file_h) & target) +
+            popcount(step<10>(n, ~(file_a | file_b)) & target) +
+            popcount(step<6>(n, ~(file_g | file_h)) & target) +
+            popcount(step<-6>(n, ~(file_a | file_b)) & target) +
+            popcount(step<-10>(n, ~(file_g | file_h)) & target) +
+            popcount(step<-15>(n, ~file_a) & target) +
+            popcount(step<-17>(n, ~file_h) & target);
+    }
+
+    template <typename V>
+    inline V king_attacks(V k)
+    {
+        return
+            step<8>(k, ~Bitboard{0}) | step<-8>(k, ~Bitboard{0}) |
+            step<1>(k, ~file_a) | step<-1>(k, ~file_h) |
+            step<9>(k, ~file_a) | step<7>(k, ~file_h) |
+            step<-7>(k, ~file_a) | step<-9>(k, ~file_h);
+    }
+}
+
+class BoardBatch
+{
+public:
+    static constexpr std::size_t max_size = 256;
+
+    void clear()
+    {
+        batch_size = 0;
+        fallback_size = 0;
+    }
+
+    std::size_t size() const
+    {
+        return batch_size;
+    }
+
+    bool full() const
+    {
+        return batch_size == max_size;
+    }
+
+    void add(const Board &board)
+    {
+        const std::size_t i = batch_size++;
+
+        const Color us = board.get_turn();
+        const Color them = (us == Color::White) ? Color::Black : Color::White;
+        const bool flip = (us == Color::Black);
+
+        for (std::uint8_t p = 0; p < 6; p++)
+        {
+            pieces[p][i] = orient(board.get_bitboard(us, static_cast<Piece>(p)), flip);
+            pieces[6+p][i] = orient(board.get_bitboard(them, static_cast<Piece>(p)), flip);
+        }
+
+        castle[i] = 0;
+        if (board.get_can_castle(us, 0))
+            bitboard_set(castle[i], 7, 0);
+        if (board.get_can_castle(us, 1))
+            bitboard_set(castle[i], 0, 0);
+
+        // En passant legality is not done set-wise, those boards are
+        // counted by the scalar move generator afterwards
+        if (board.get_ep() != 9)
+        {
+            fallback_index[fallback_size] = i;
+            fallback_boards[fallback_size] = board;
+            fallback_size++;
+        }
+
+        flipped[i] = flip;
+    }
+
+    // Computes move_count() and enemy_threat() for every board in the batch
+    void generate()
+    {
+        // Pad to a whole number of vectors with empty boards
+        std::size_t padded = batch_size;
+        while (padded % batch_lanes::Native::width != 0)
+        {
+            for (std::uint8_t p = 0; p < 12; p++)
+                pieces[p][padded] = 0;
+            castle[padded] = 0;
+            padded++;
+        }
+
+        for (std::size_t i = 0; i < padded; i += batch_lanes::Native::width)
+            generate_lanes<batch_lanes::Native>(i);
+
+        for (std::size_t f = 0; f < fallback_size; f++)
+        {
+            MoveList movelist;
+            fallback_boards[f].get_moves(movelist);
+            move_counts[fallback_index[f]] = movelist.size();
+        }
+    }
+
+    // Same as the size of the list from Board::get_moves()
+    std::uint64_t move_count(std::size_t i) const
+    {
+        return move_counts[i];
+    }
+
+    // Same as Board::get_enemy_threat()
+    Bitboard enemy_threat(std::size_t i) const
+    {
+        return orient(enemy_threats[i], flipped[i]);
+    }
+
+private:
+    static Bitboard orient(Bitboard b, bool flip)
+    {
+        return flip ? __builtin_bswap64(b) : b;
+    }
+
+    template <typename V>
+    void generate_lanes(std::size_t i)
+    {
+        using namespace batch_lanes;
+
+        const V zero = V::all(0);
+
+        const V pawns   = V::load(&pieces[0][i]);
+        const V knights = V::load(&pieces[1][i]);
+        const V bishops = V::load(&pieces[2][i]);
+        const V rooks   = V::load(&pieces[3][i]);
+        const V queens  = V::load(&pieces[4][i]);
+        const V king    = V::load(&pieces[5][i]);
+
+        const V their_pawns   = V::load(&pieces[6][i]);
+        const V their_knights = V::load(&pieces[7][i]);
+        const V their_diag    = V::load(&pieces[8][i]) | V::load(&pieces[10][i]);
+        const V their_orth    = V::load(&pieces[9][i]) | V::load(&pieces[10][i]);
+        const V their_king    = V::load(&pieces[11][i]);
+
+        const V own = pawns | knights | bishops | rooks | queens | king;
+        const V occ = own | their_pawns | their_knights | their_diag | their_orth | their_king;
+        const V empty = ~occ;
+
+        // Enemy attacks, sliding through our king
+        V threat =
+            step<-9>(their_pawns, ~file_h) | step<-7>(their_pawns, ~file_a) |
+            knight_attacks(their_knights) |
+            king_attacks(their_king);
+        {
+            const V e = empty | king;
+            threat = threat |
+                slide<8>(their_orth, e, ~Bitboard{0}) | slide<-8>(their_orth, e, ~Bitboard{0}) |
+                slide<1>(their_orth, e, ~file_a) | slide<-1>(their_orth, e, ~file_h) |
+                slide<9>(their_diag, e, ~file_a) | slide<-9>(their_diag, e, ~file_h) |
+                slide<7>(their_diag, e, ~file_h) | slide<-7>(their_diag, e, ~file_a);
+        }
+
+        // Checkers and pins, looking outward from our king
+        V checkers =
+            (their_pawns & (step<7>(king, ~file_h) | step<9>(king, ~file_a))) |
+            (their_knights & knight_attacks(king));
+        V between = zero;
+        std::array<V, 4> pin_axis = {zero, zero, zero, zero}; // File, rank, diagonal, anti-diagonal
+
+        const auto look = [&](auto dir, Bitboard wrap, V sliders, std::uint8_t axis)
+        {
+            constexpr int S = decltype(dir)::value;
+
+            const V ray = slide<S>(king, empty, wrap);
+            const V first = ray & occ;
+            const V checker = first & sliders;
+
+            checkers = checkers | checker;
+            between = between | (ray & ~first & nonzero(checker));
+
+            const V candidate = first & own;
+            const V pinner = slide<S>(candidate, empty, wrap) & sliders;
+            pin_axis[axis] = pin_axis[axis] | (candidate & nonzero(pinner));
+        };
+
+        look(std::integral_constant<int, 8>{},  ~Bitboard{0}, their_orth, 0);
+        look(std::integral_constant<int, -8>{}, ~Bitboard{0}, their_orth, 0);
+        look(std::integral_constant<int, 1>{},  ~file_a, their_orth, 1);
+        look(std::integral_constant<int, -1>{}, ~file_h, their_orth, 1);
+        look(std::integral_constant<int, 9>{},  ~file_a, their_diag, 2);
+        look(std::integral_constant<int, -9>{}, ~file_h, their_diag, 2);
+        look(std::integral_constant<int, 7>{},  ~file_h, their_diag, 3);
+        look(std::integral_constant<int, -7>{}, ~file_a, their_diag, 3);
+
+        const V pinned = pin_axis[0] | pin_axis[1] | pin_axis[2] | pin_axis[3];
+
+        // No check: anywhere, single check: capture or block, double check: king only
+        const V checker_count = popcount(checkers);
+        const V not_in_check = equal(checker_count, zero);
+        const V check_mask =
+            not_in_check |
+            (equal(checker_count, V::all(1)) & (checkers | between));
+
+        const V target = ~own & check_mask;
+
+        V count = zero;
+
+        // King
+        count = count + popcount(king_attacks(king) & ~own & ~threat);
+
+        // Knights
+        count = count + knight_count(knights & ~pinned, target);
+
+        // Sliders, a pinned slider may still move along the pin
+        {
+            const V orth = rooks | queens;
+            const V diag = bishops | queens;
+
+            const V n_s  = orth & (~pinned | pin_axis[0]);
+            const V e_w  = orth & (~pinned | pin_axis[1]);
+            const V ne_sw = diag & (~pinned | pin_axis[2]);
+            const V nw_se = diag & (~pinned | pin_axis[3]);
+
+            count = count +
+                popcount(slide<8>(n_s, empty, ~Bitboard{0}) & target) +
+                popcount(slide<-8>(n_s, empty, ~Bitboard{0}) & target) +
+                popcount(slide<1>(e_w, empty, ~file_a) & target) +
+                popcount(slide<-1>(e_w, empty, ~file_h) & target) +
+                popcount(slide<9>(ne_sw, empty, ~file_a) & target) +
+                popcount(slide<-9>(ne_sw, empty, ~file_h) & target) +
+                popcount(slide<7>(nw_se, empty, ~file_h) & target) +
+                popcount(slide<-7>(nw_se, empty, ~file_a) & target);
+        }
+
+        // Pawns, promotions count four times
+        {
+            const V promo = V::all(rank_8);
+            const V them = occ & ~own;
+
+            const V single = step<8>(pawns & (~pinned | pin_axis[0]), ~Bitboard{0}) & empty;
+            const V dbl = step<8>(single & V::all(rank_3), ~Bitboard{0}) & empty & check_mask;
+            const V push = single & check_mask;
+            const V cap_ne = step<9>(pawns & (~pinned | pin_axis[2]), ~file_a) & them & check_mask;
+            const V cap_nw = step<7>(pawns & (~pinned | pin_axis[3]), ~file_h) & them & check_mask;
+
+            count = count +
+                popcount(push & ~promo) + popcount(dbl) +
+                popcount(cap_ne & ~promo) + popcount(cap_nw & ~promo);
+
+            const V promos = popcount(push & promo) + popcount(cap_ne & promo) + popcount(cap_nw & promo);
+            count = count + promos + promos + promos + promos;
+        }
+
+        // Castling
+        {
+            const V castle_rooks = V::load(&castle[i]);
+            const V one = V::all(1);
+
+            const V king_side =
+                nonzero(castle_rooks & V::all(0x80)) &
+                equal(occ & V::all(0x60), zero) &
+                equal(threat & V::all(0x70), zero);
+
+            const V queen_side =
+                nonzero(castle_rooks & V::all(0x01)) &
+                equal(occ & V::all(0x0e), zero) &
+                equal(threat & V::all(0x1c), zero);
+
+            count = count + (king_side & not_in_check & one) + (queen_side & not_in_check & one);
+        }
+
+        count.store(&move_counts[i]);
+        threat.store(&enemy_threats[i]);
+    }
+
+    std::size_t batch_size = 0;
+
+    // Our pieces 0-5, their pieces 6-11, in Piece order
+    alignas(32) std::array<std::array<Bitboard, max_size>, 12> pieces;
+    alignas(32) std::array<Bitboard, max_size> castle; // Rook squares we may castle with
+    std::array<bool, max_size> flipped;
+
+    alignas(32) std::array<Bitboard, max_size> move_counts;
+    alignas(32) std::array<Bitboard, max_size> enemy_threats;
+
+    std::size_t fallback_size = 0;
+    std::array<std::size_t, max_size> fallback_index;
+    std::array<Board, max_size> fallback_boards;
+};
+
+#endif
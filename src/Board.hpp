@@ -3,10 +3,16 @@
 
 #include "utility.hpp"
 #include "Bitboard.hpp"
+#include "Endgame.hpp"
+#include "evaluation.hpp"
+#include "KoggeStone.hpp"
 #include "Move.hpp"
+#include "NNUE.hpp"
+#include "PawnTable.hpp"
 #include "movegen_rays.hpp"
 #include "zobrist.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <iostream>
@@ -24,7 +30,13 @@ public:
         pieces(b.pieces),
         turn(b.turn),
         can_castle(b.can_castle),
-        ep_x(b.ep_x)
+        ep_x(b.ep_x),
+        psqt_mg(b.psqt_mg),
+        psqt_eg(b.psqt_eg),
+        phase(b.phase),
+        pawn_key(b.pawn_key),
+        material_key(b.material_key),
+        accumulator(b.accumulator)
     {
     }
 
@@ -33,15 +45,27 @@ public:
         pieces(b.pieces),
         turn(b.turn),
         can_castle(b.can_castle),
-        ep_x(b.ep_x)
+        ep_x(b.ep_x),
+        psqt_mg(b.psqt_mg),
+        psqt_eg(b.psqt_eg),
+        phase(b.phase),
+        pawn_key(b.pawn_key),
+        material_key(b.material_key),
+        accumulator(b.accumulator)
     {
         perform_move(m);
     }
 
+    // Copies the caches too, perform_move and set_turn reset them
+    Board& operator=(const Board &b) = default;
+
     Board(std::string FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1")
     {
         colors.at(static_cast<std::uint8_t>(Color::Empty)) = ~0;
 
+        if (nnue::active())
+            accumulator.reset();
+
         std::vector<std::string> tokens;
 
         std::istringstream iss(FEN);
@@ -150,8 +174,11 @@ public:
             ep_x = tokens.at(3).at(0) - 'a';
         }
 
-        repeatable_movecount = std::stoi(tokens.at(4));
-        turn_number = std::stoi(tokens.at(5));
+        // Halfmove clock and fullmove number are optional (EPD style)
+        if (tokens.size() > 4)
+            repeatable_movecount = std::stoi(tokens.at(4));
+        if (tokens.size() > 5)
+            turn_number = std::stoi(tokens.at(5));
     }
 
     Color get_color(std::uint8_t x, std::uint8_t y) const
@@ -234,6 +261,9 @@ public:
         std::uint8_t x = static_cast<std::uint8_t>(x_);
         std::uint8_t y = static_cast<std::uint8_t>(y_);
 
+        incremental_update(y*8+x, get_tile(x, y), -1);
+        incremental_update(y*8+x, tile, 1);
+
         for (std::uint8_t c = 0; c < 3; c++)
         {
             bitboard_unset(colors[c], x, y);
@@ -254,6 +284,9 @@ public:
 
     void set_tile(Square sq, Tile tile)
     {
+        incremental_update(sq, get_tile(sq), -1);
+        incremental_update(sq, tile, 1);
+
         for (std::uint8_t c = 0; c < 3; c++)
         {
             bitboard_unset(colors[c], sq);
@@ -277,6 +310,16 @@ public:
         return colors[static_cast<std::uint8_t>(color)] & pieces[static_cast<std::uint8_t>(piece)];
     }
 
+    Bitboard get_bitboard(Piece piece) const
+    {
+        return pieces[static_cast<std::uint8_t>(piece)];
+    }
+
+    Bitboard get_bitboard(Color color) const
+    {
+        return colors[static_cast<std::uint8_t>(color)];
+    }
+
     /*
     bool is_checkmate(const MoveList& movelist) const
     {
@@ -313,7 +356,7 @@ public:
         get_moves(movelist, z_list);
     }
 
-    void get_moves(MoveList& movelist, std::vector<std::uint64_t> z_list, bool debug = false) const
+    void get_moves(MoveList& movelist, const std::vector<std::uint64_t> &z_list, bool debug = false) const
     {
         ray_movegen(movelist);
 
@@ -372,6 +415,154 @@ public:
         }
     }
 
+    // Legal captures, en passant and promotions only, generated as such. In
+    // check all evasions are generated and checkmate is flagged. Stalemate
+    // is only flagged by the fifty move rule, as quiet moves are not looked
+    // for.
+    void get_captures(MoveList& movelist) const
+    {
+        ray_movegen(movelist, true);
+
+        if (movelist.size() == 0 && checkers != 0)
+        {
+            movelist.is_checkmate = true;
+        }
+
+        if (!movelist.is_checkmate && repeatable_movecount == 100)
+        {
+            movelist.is_stalemate = true;
+        }
+    }
+
+    // Pieces of both colours attacking sq, with only the pieces in occupancy
+    // on the board. Sliders see through squares left out of occupancy.
+    Bitboard attackers_to(Square sq, Bitboard occupancy) const
+    {
+        const Bitboard target = Bitboard{1} << sq;
+
+        const Bitboard diag = get_bitboard(Piece::Bishop) | get_bitboard(Piece::Queen);
+        const Bitboard orth = get_bitboard(Piece::Rook) | get_bitboard(Piece::Queen);
+
+        return occupancy & (
+            (pawn_attacks_setwise(target, false) & get_bitboard(Color::White, Piece::Pawn)) |
+            (pawn_attacks_setwise(target, true) & get_bitboard(Color::Black, Piece::Pawn)) |
+            (knight_attacks_setwise(target) & get_bitboard(Piece::Knight)) |
+            (king_attacks_setwise(target) & get_bitboard(Piece::King)) |
+            (bishop_attacks_setwise(target, occupancy) & diag) |
+            (rook_attacks_setwise(target, occupancy) & orth));
+    }
+
+    // Static exchange evaluation, the material the side to move wins by
+    // making the move and then recapturing on its square with the least
+    // valuable piece for as long as it pays. Pins are not considered.
+    Score see(Move move) const
+    {
+        using eval_tables::piece_values;
+
+        if (move.get_type() == MoveSpecial::Castling)
+            return 0;
+
+        const Square to_sq = move.get_to();
+        Bitboard occupancy = ~colors[static_cast<std::uint8_t>(Color::Empty)];
+        Piece piece = get_piece(move.get_from());
+
+        // Material balance after each capture, from the point of view of the
+        // side making it
+        std::array<Score, 32> gain;
+        gain[0] = see_victim(move, occupancy);
+
+        if (move.get_type() == MoveSpecial::Promotion)
+            piece = move.get_promo();
+
+        Bitboard attackers = attackers_to(to_sq, occupancy);
+        Bitboard from = Bitboard{1} << move.get_from();
+        Color side = turn;
+        std::uint8_t d = 0;
+
+        while (true)
+        {
+            d++;
+            gain[d] = piece_values[static_cast<std::uint8_t>(piece)] - gain[d-1];
+
+            occupancy ^= from;
+            attackers = see_xrays(to_sq, occupancy, attackers);
+
+            side = (side == Color::White) ? Color::Black : Color::White;
+            from = see_least_valuable(attackers & colors[static_cast<std::uint8_t>(side)], piece);
+
+            if (from == 0)
+                break;
+
+            // The king may only take when nothing can take it back
+            if (piece == Piece::King && (attackers & ~colors[static_cast<std::uint8_t>(side)]) != 0)
+                break;
+        }
+
+        while (--d)
+            gain[d-1] = -std::max(-gain[d-1], gain[d]);
+
+        return gain[0];
+    }
+
+    // Whether see(move) is at least threshold, stopping as soon as the
+    // exchange is known to end on either side of it
+    bool see_ge(Move move, Score threshold) const
+    {
+        using eval_tables::piece_values;
+
+        if (move.get_type() == MoveSpecial::Castling)
+            return 0 >= threshold;
+
+        const Square to_sq = move.get_to();
+        Bitboard occupancy = ~colors[static_cast<std::uint8_t>(Color::Empty)];
+        Piece piece = get_piece(move.get_from());
+
+        // What the side to move is ahead of the threshold if the exchange
+        // stopped now, negated after every capture
+        Score swap = see_victim(move, occupancy) - threshold;
+        if (swap < 0)
+            return false;
+
+        if (move.get_type() == MoveSpecial::Promotion)
+            piece = move.get_promo();
+
+        swap = piece_values[static_cast<std::uint8_t>(piece)] - swap;
+        if (swap <= 0)
+            return true;
+
+        occupancy ^= Bitboard{1} << move.get_from();
+
+        Bitboard attackers = attackers_to(to_sq, occupancy);
+        Color side = turn;
+        bool result = true;
+
+        while (true)
+        {
+            side = (side == Color::White) ? Color::Black : Color::White;
+
+            const Bitboard ours = attackers & colors[static_cast<std::uint8_t>(side)];
+            const Bitboard from = see_least_valuable(ours, piece);
+
+            if (from == 0)
+                break;
+
+            result = !result;
+
+            // The king may only take when nothing can take it back
+            if (piece == Piece::King)
+                return ((attackers & ~ours) != 0) ? !result : result;
+
+            swap = piece_values[static_cast<std::uint8_t>(piece)] - swap;
+            if (swap < static_cast<Score>(result))
+                break;
+
+            occupancy ^= from;
+            attackers = see_xrays(to_sq, occupancy, attackers);
+        }
+
+        return result;
+    }
+
     Bitboard& get_threat() const
     {
         static_analysis();
@@ -386,6 +577,14 @@ public:
         return enemy_threat;
     }
 
+    // By colour, then pawn, knight, diagonal, orthogonal and king attacks
+    const std::array<std::array<Bitboard, 5>, 2>& get_attack_maps() const
+    {
+        static_analysis();
+
+        return attack_maps;
+    }
+
     Bitboard& get_checkers() const
     {
         static_analysis();
@@ -424,11 +623,80 @@ public:
         return turn;
     }
 
+    // Side 0 is king side, 1 is queen side
+    bool get_can_castle(Color color, std::uint8_t side) const
+    {
+        return can_castle[static_cast<std::uint8_t>(color)][side];
+    }
+
     std::uint8_t get_ep() const
     {
         return ep_x;
     }
 
+    std::string get_fen() const
+    {
+        std::string fen;
+
+        for (std::int8_t y = 7; y >= 0; y--)
+        {
+            std::uint8_t empty = 0;
+
+            for (std::uint8_t x = 0; x < 8; x++)
+            {
+                const Tile t = get_tile(x, y);
+
+                if (t.piece == Piece::None)
+                {
+                    empty++;
+                    continue;
+                }
+
+                if (empty != 0)
+                    fen += static_cast<char>('0'+empty);
+                empty = 0;
+
+                fen += tile_to_char(t);
+            }
+
+            if (empty != 0)
+                fen += static_cast<char>('0'+empty);
+
+            if (y != 0)
+                fen += '/';
+        }
+
+        fen += (turn == Color::White) ? " w " : " b ";
+
+        std::string castle;
+        if (can_castle[0][0])
+            castle += 'K';
+        if (can_castle[0][1])
+            castle += 'Q';
+        if (can_castle[1][0])
+            castle += 'k';
+        if (can_castle[1][1])
+            castle += 'q';
+        if (castle.empty())
+            castle = "-";
+
+        fen += castle + ' ';
+
+        if (ep_x == 9)
+        {
+            fen += '-';
+        }
+        else
+        {
+            fen += static_cast<char>('a'+ep_x);
+            fen += (turn == Color::White) ? '6' : '3';
+        }
+
+        fen += ' ' + std::to_string(repeatable_movecount) + ' ' + std::to_string(turn_number);
+
+        return fen;
+    }
+
     void perform_move(Move move)
     {
         const Tile from = get_tile(move.get_from());
@@ -554,6 +822,34 @@ public:
         zobrist_hash = 0;
     }
 
+    // Hands the turn to the other side without moving, for null move
+    // pruning. Not legal when in check.
+    void pass()
+    {
+        std::uint64_t z = get_zobrist() ^ zobrist_black;
+
+        if (ep_x != 9)
+            z ^= zobrist_ep[ep_x];
+
+        ep_x = 9;
+        repeatable_movecount++;
+
+        movetohere = Move();
+        typetohere = MoveType::Quiet;
+
+        if (get_turn() == Color::White)
+        {
+            set_turn(Color::Black);
+        }
+        else
+        {
+            turn_number++;
+            set_turn(Color::White);
+        }
+
+        zobrist_hash = z;
+    }
+
     std::uint64_t get_zobrist() const
     {
         if (zobrist_hash != 0)
@@ -592,7 +888,7 @@ public:
         return zobrist_hash;
     }
 
-    double basic_eval(const MoveList& movelist) const
+    Score basic_eval(const MoveList& movelist) const
     {
         if (movelist.size() == 0)
         {
@@ -600,237 +896,130 @@ public:
                 return 0;
 
             if (turn == Color::White)
-                return -200.00;
+                return mated_in(0);
 
             if (turn == Color::Black)
-                return 200.00;
+                return mate_in(0);
         }
 
-        double eval = 0;
+        constexpr std::array<Score, 5> values = {100, 300, 300, 500, 900};
 
-        for (std::uint8_t x = 0; x < 8; x++)
-        {
-            for (std::uint8_t y = 0; y < 8; y++)
-            {
-                Tile t = get_tile(x, y);
+        Score eval = 0;
 
-                double pv = 0;
-
-                switch (t.piece)
-                {
-                    case Piece::None:   pv = 0; break;
-                    case Piece::Pawn:   pv = 1; break;
-                    case Piece::Knight: pv = 3; break;
-                    case Piece::Bishop: pv = 3; break;
-                    case Piece::Rook:   pv = 5; break;
-                    case Piece::Queen:  pv = 9; break;
-                    default:            pv = 0; break;
-                }
-
-                if (t.color == Color::White)
-                    eval += pv;
-                else if (t.color == Color::Black)
-                    eval -= pv;
-            }
+        for (std::uint8_t p = 0; p < 5; p++)
+        {
+            eval += values[p]*bitboard_count(get_bitboard(Color::White, static_cast<Piece>(p)));
+            eval -= values[p]*bitboard_count(get_bitboard(Color::Black, static_cast<Piece>(p)));
         }
 
         return eval;
     }
 
-    // Created based on "Simplified Evalution Function" on Chess Programming Wiki
-    double adv_eval(const MoveList& movelist) const
+    // Score from white's point of view in centipawns. ply is the distance from
+    // the root, so that a mate found here is scored by its distance. The pawn
+    // table is optional.
+    Score adv_eval(const MoveList& movelist, int ply = 0, PawnTable *pawn_table = nullptr) const
     {
-        // Piece values
-        constexpr std::array<double, 6> piece_values = {1.00, 3.20, 3.30, 5.00, 9.00, 200.00};
-
-        // Pawn Piece-Square Table
-        constexpr std::array<double, 64> pawn_ps =
-        {
-             0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00,
-             0.50, 0.50, 0.50, 0.50, 0.50, 0.50, 0.50, 0.50,
-             0.10, 0.10, 0.20, 0.30, 0.30, 0.20, 0.10, 0.10,
-             0.05, 0.05, 0.10, 0.25, 0.25, 0.10, 0.05, 0.05,
-             0.00, 0.00, 0.00, 0.20, 0.20, 0.00, 0.00, 0.00,
-             0.05,-0.05,-0.10, 0.00, 0.00,-0.10,-0.05, 0.05,
-             0.05, 0.10, 0.10,-0.20,-0.20, 0.10, 0.10, 0.05,
-             0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00
-        };
+        Score score;
+        if (terminal_eval(movelist, ply, score))
+            return score;
 
-        // Knight Piece-Square Table
-        constexpr std::array<double, 64> knight_ps =
-        {
-            -0.50,-0.40,-0.30,-0.30,-0.30,-0.30,-0.40,-0.50,
-            -0.40,-0.20, 0.00, 0.00, 0.00, 0.00,-0.20,-0.40,
-            -0.30, 0.00, 0.10, 0.15, 0.15, 0.10, 0.00,-0.30,
-            -0.30, 0.05, 0.15, 0.20, 0.20, 0.15, 0.05,-0.30,
-            -0.30, 0.00, 0.15, 0.20, 0.20, 0.15, 0.00,-0.30,
-            -0.30, 0.05, 0.10, 0.15, 0.15, 0.10, 0.05,-0.30,
-            -0.40,-0.20, 0.00, 0.05, 0.05, 0.00,-0.20,-0.40,
-            -0.50,-0.40,-0.30,-0.30,-0.30,-0.30,-0.40,-0.50
-        };
-
-        // Bishop Piece-Square Table
-        constexpr std::array<double, 64> bishop_ps =
-        {
-            -0.20,-0.10,-0.10,-0.10,-0.10,-0.10,-0.10,-0.20,
-            -0.10, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00,-0.10,
-            -0.10, 0.00, 0.05, 0.10, 0.10, 0.05, 0.00,-0.10,
-            -0.10, 0.05, 0.05, 0.10, 0.10, 0.05, 0.05,-0.10,
-            -0.10, 0.00, 0.10, 0.10, 0.10, 0.10, 0.00,-0.10,
-            -0.10, 0.10, 0.10, 0.10, 0.10, 0.10, 0.10,-0.10,
-            -0.10, 0.05, 0.00, 0.00, 0.00, 0.00, 0.05,-0.10,
-            -0.20,-0.10,-0.10,-0.10,-0.10,-0.10,-0.10,-0.20
-        };
+        return tapered_eval(psqt_mg, psqt_eg, phase, pawn_table);
+    }
 
-        // Rook Piece-Square Table
-        constexpr std::array<double, 64> rook_ps =
-        {
-             0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00,
-             0.05, 0.10, 0.10, 0.10, 0.10, 0.10, 0.10, 0.05,
-            -0.05, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00,-0.05,
-            -0.05, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00,-0.05,
-            -0.05, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00,-0.05,
-            -0.05, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00,-0.05,
-            -0.05, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00,-0.05,
-             0.00, 0.00, 0.00, 0.05, 0.05, 0.00, 0.00, 0.00
-        };
+    // adv_eval against a search window, from white's point of view. When the
+    // incremental material and piece-square score alone is further than
+    // lazy_margin outside the window, the other terms are assumed not to
+    // bring it back inside. That score is returned as is and exact is set to
+    // false. Known and scaled endgames are always evaluated in full.
+    Score adv_eval_lazy(const MoveList& movelist, int ply, Score alpha, Score beta, PawnTable *pawn_table, bool &exact) const
+    {
+        exact = true;
 
-        // Queen Piece-Square Table
-        constexpr std::array<double, 64> queen_ps =
-        {
-            -0.20,-0.10,-0.10,-0.05,-0.05,-0.10,-0.10,-0.20,
-            -0.10, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00,-0.10,
-            -0.10, 0.00, 0.05, 0.05, 0.05, 0.05, 0.00,-0.10,
-            -0.05, 0.00, 0.05, 0.05, 0.05, 0.05, 0.00,-0.05,
-             0.00, 0.00, 0.05, 0.05, 0.05, 0.05, 0.00,-0.05,
-            -0.10, 0.05, 0.05, 0.05, 0.05, 0.05, 0.00,-0.10,
-            -0.10, 0.00, 0.05, 0.00, 0.00, 0.00, 0.00,-0.10,
-            -0.20,-0.10,-0.10,-0.05,-0.05,-0.10,-0.10,-0.20
-        };
+        Score score;
+        if (terminal_eval(movelist, ply, score))
+            return score;
 
-        // King middle-game Piece-Square Table
-        constexpr std::array<double, 64> king_middle_ps =
-        {
-            -0.30,-0.40,-0.40,-0.50,-0.50,-0.40,-0.40,-0.30,
-            -0.30,-0.40,-0.40,-0.50,-0.50,-0.40,-0.40,-0.30,
-            -0.30,-0.40,-0.40,-0.50,-0.50,-0.40,-0.40,-0.30,
-            -0.30,-0.40,-0.40,-0.50,-0.50,-0.40,-0.40,-0.30,
-            -0.20,-0.30,-0.30,-0.40,-0.40,-0.30,-0.30,-0.20,
-            -0.10,-0.20,-0.20,-0.20,-0.20,-0.20,-0.20,-0.10,
-             0.20, 0.20, 0.00, 0.00, 0.00, 0.00, 0.20, 0.20,
-             0.20, 0.30, 0.10, 0.00, 0.00, 0.10, 0.30, 0.20
-        };
+        const Score psqt = blend(psqt_mg, psqt_eg, phase);
 
-        // King end-game Piece-Square Table
-        constexpr std::array<double, 64> king_end_ps =
-        {
-            -0.50,-0.40,-0.30,-0.20,-0.20,-0.30,-0.40,-0.50,
-            -0.30,-0.20,-0.10, 0.00, 0.00,-0.10,-0.20,-0.30,
-            -0.30,-0.10, 0.20, 0.30, 0.30, 0.20,-0.10,-0.30,
-            -0.30,-0.10, 0.30, 0.40, 0.40, 0.30,-0.10,-0.30,
-            -0.30,-0.10, 0.30, 0.40, 0.40, 0.30,-0.10,-0.30,
-            -0.30,-0.10, 0.20, 0.30, 0.30, 0.20,-0.10,-0.30,
-            -0.30,-0.30, 0.00, 0.00, 0.00, 0.00,-0.30,-0.30,
-            -0.50,-0.30,-0.30,-0.30,-0.30,-0.30,-0.30,-0.50
-        };
+        if (!endgame::special(material_key) && (psqt + eval_tables::lazy_margin <= alpha || psqt - eval_tables::lazy_margin >= beta))
+        {
+            exact = false;
+            return psqt;
+        }
 
-        if (movelist.is_stalemate)
-            return 0;
+        return tapered_eval(psqt_mg, psqt_eg, phase, pawn_table);
+    }
 
-        if (movelist.is_checkmate)
-        {
-            if (turn == Color::White)
-                return -200.00;
+    // Same as adv_eval, with the material and piece-square sums recomputed
+    // from the bitboards instead of the incremental ones
+    Score adv_eval_from_scratch(const MoveList& movelist, int ply = 0, PawnTable *pawn_table = nullptr) const
+    {
+        Score score;
+        if (terminal_eval(movelist, ply, score))
+            return score;
 
-            if (turn == Color::Black)
-                return 200.00;
-        }
+        Score mg, eg;
+        int ph;
+        psqt_from_scratch(mg, eg, ph);
 
-        double eval = 0;
+        return tapered_eval(mg, eg, ph, pawn_table);
+    }
 
-        // 0 is middle game, 1 is end game, can interpolate between
-        double endgameness = 0;
+    // Material and piece-square sums per piece type, popping the squares of
+    // each piece bitboard
+    void psqt_from_scratch(Score &mg, Score &eg, int &ph) const
+    {
+        mg = 0;
+        eg = 0;
+        ph = 0;
 
+        for (std::uint8_t p = 0; p < 6; p++)
         {
-            Bitboard white_pieces = colors[static_cast<std::uint8_t>(Color::White)] - get_bitboard(Color::White, Piece::Pawn);
-            Bitboard black_pieces = colors[static_cast<std::uint8_t>(Color::Black)] - get_bitboard(Color::Black, Piece::Pawn);
+            Bitboard white = get_bitboard(Color::White, static_cast<Piece>(p));
+            Bitboard black = get_bitboard(Color::Black, static_cast<Piece>(p));
 
-            if (
-                    ((get_bitboard(Color::White, Piece::Queen) == 0) && (bitboard_count(white_pieces) <= 1)) ||
-                    ((get_bitboard(Color::Black, Piece::Queen) == 0) && (bitboard_count(black_pieces) <= 1))
-               )
-            {
-                endgameness = 1;
-            }
+            ph += eval_tables::phase_weights[p]*bitboard_count(white | black);
 
-            if ((bitboard_count(white_pieces) >= 2) && (bitboard_count(white_pieces) <= 4))
+            while (white)
             {
-                if(bitboard_count(get_bitboard(Color::White, Piece::Bishop)) == 2)
-                {
-                    eval += 0.35;
-                }
+                const Square sq = bitboard_bitscan_forward_pop(white);
+                mg += eval_tables::psqt_mg[p][sq];
+                eg += eval_tables::psqt_eg[p][sq];
             }
 
-            if ((bitboard_count(black_pieces) >= 2) && (bitboard_count(black_pieces) <= 4))
+            while (black)
             {
-                if(bitboard_count(get_bitboard(Color::Black, Piece::Bishop)) == 2)
-                {
-                    eval -= 0.35;
-                }
+                const Square sq = bitboard_bitscan_forward_pop(black) ^ 56;
+                mg -= eval_tables::psqt_mg[p][sq];
+                eg -= eval_tables::psqt_eg[p][sq];
             }
         }
+    }
 
-        int wPawnsFile = 0, bPawnsFile = 0;
+    // Network evaluation, same conventions as adv_eval. Needs an active
+    // network, else adv_eval is used.
+    Score nnue_eval(const MoveList& movelist, int ply = 0) const
+    {
+        Score score;
+        if (terminal_eval(movelist, ply, score))
+            return score;
 
-        for (std::uint8_t x = 0; x < 8; x++)
+        // Boards made before the network was enabled have no accumulators
+        if (!accumulator.active())
         {
-            for (std::uint8_t y = 0; y < 8; y++)
-            {
-                Tile t = get_tile(x, y);
-
-                if (t.piece == Piece::None)
-                    continue;
-
-                std::uint8_t index = (7-y)*8+x; // For Piece-Square Tables for white
-                if (t.color == Color::Black)
-                    index = y*8+x; // For black (reflected, not rotated)
-
-                double pv = piece_values[static_cast<std::uint8_t>(t.piece)];
+            if (!nnue::active())
+                return adv_eval(movelist, ply);
 
-                switch (t.piece)
-                {
-                    case Piece::Pawn:
-                        pv += pawn_ps[index];
-
-                        if (t.color == Color::Black)
-                            bPawnsFile += 1;
-
-                        else
-                            wPawnsFile += 1;
-                        break;
-                    case Piece::Knight: pv += knight_ps[index]; break;
-                    case Piece::Bishop: pv += bishop_ps[index]; break;
-                    case Piece::Rook:   pv += rook_ps[index]; break;
-                    case Piece::Queen:  pv += queen_ps[index]; break;
-                    case Piece::King:   pv += endgameness*king_end_ps[index] + (1-endgameness)*king_middle_ps[index]; break;
-                    default: break;
-                }
-
-                if (t.color == Color::White)
-                    eval += pv;
-                else
-                    eval -= pv;
-            }
-            if (wPawnsFile >= 2)
-                eval -= 0.35;
-            if (bPawnsFile >= 2)
-                eval += 0.35;
-
-            wPawnsFile = 0;
-            bPawnsFile = 0;
+            Board b(*this);
+            b.refresh_incremental();
+            return b.nnue_eval(movelist, ply);
         }
 
-        return eval;
+        if (turn == Color::White)
+            return nnue::evaluate(accumulator[0], accumulator[1]);
+        else
+            return -nnue::evaluate(accumulator[1], accumulator[0]);
     }
 
     void print(std::ostream &os = std::cout) const
@@ -881,13 +1070,350 @@ public:
         os << std::endl;
     }
 
+    // Recomputes the incremental material and piece-square sums and the pawn
+    // and material keys from scratch
+    void refresh_incremental()
+    {
+        psqt_mg = 0;
+        psqt_eg = 0;
+        phase = 0;
+        pawn_key = 0;
+        material_key = 0;
+
+        if (nnue::active())
+            accumulator.reset();
+        else
+            accumulator = nnue::AccumulatorPair();
+
+        for (Color c : {Color::White, Color::Black})
+        {
+            for (std::uint8_t p = 0; p < 6; p++)
+            {
+                Bitboard b = get_bitboard(c, static_cast<Piece>(p));
+
+                while (b)
+                    incremental_update(bitboard_bitscan_forward_pop(b), Tile{c, static_cast<Piece>(p)}, 1);
+            }
+        }
+    }
+
+    bool incremental_equal(const Board &b) const
+    {
+        return psqt_mg == b.psqt_mg && psqt_eg == b.psqt_eg && phase == b.phase && pawn_key == b.pawn_key &&
+            material_key == b.material_key && accumulator == b.accumulator;
+    }
+
+    // Network accumulators, only valid while a network is active
+    const nnue::AccumulatorPair& get_accumulators() const
+    {
+        return accumulator;
+    }
+
+    std::uint64_t get_pawn_key() const
+    {
+        return pawn_key;
+    }
+
+    std::uint64_t get_material_key() const
+    {
+        return material_key;
+    }
+
+    // Bitboards by colour and piece for the endgame functions
+    endgame::Position endgame_position() const
+    {
+        endgame::Position pos;
+
+        for (std::uint8_t c = 0; c < 2; c++)
+            for (std::uint8_t p = 0; p < 6; p++)
+                pos.pieces[c][p] = colors[c] & pieces[p];
+
+        pos.turn = turn;
+
+        return pos;
+    }
+
+    // Pawn structure from scratch: doubled, isolated and passed pawns
+    PawnEntry evaluate_pawns() const
+    {
+        using namespace eval_tables;
+
+        PawnEntry entry;
+        entry.key = pawn_key;
+
+        const Bitboard white_pawns = get_bitboard(Color::White, Piece::Pawn);
+        const Bitboard black_pawns = get_bitboard(Color::Black, Piece::Pawn);
+
+        // Doubled pawns, once per file
+        for (std::uint8_t x = 0; x < 8; x++)
+        {
+            if (bitboard_count(white_pawns & (file_a << x)) >= 2)
+                entry.score -= doubled_pawns;
+            if (bitboard_count(black_pawns & (file_a << x)) >= 2)
+                entry.score += doubled_pawns;
+        }
+
+        // Isolated pawns have no own pawns on the neighbouring files
+        const auto neighbour_files = [](Bitboard pawns)
+        {
+            const Bitboard files = fill_north(fill_south(pawns));
+            return ((files << 1) & not_a) | ((files >> 1) & not_h);
+        };
+
+        entry.score -= isolated_pawn*bitboard_count(white_pawns & ~neighbour_files(white_pawns));
+        entry.score += isolated_pawn*bitboard_count(black_pawns & ~neighbour_files(black_pawns));
+
+        // Passed pawns have no enemy pawns ahead on their own or the
+        // neighbouring files, only the front one of doubled pawns counts
+        const auto with_neighbours = [](Bitboard b)
+        {
+            return b | ((b << 1) & not_a) | ((b >> 1) & not_h);
+        };
+
+        entry.passed[0] = white_pawns & ~with_neighbours(fill_south(black_pawns >> 8)) & ~fill_south(white_pawns >> 8);
+        entry.passed[1] = black_pawns & ~with_neighbours(fill_north(white_pawns << 8)) & ~fill_north(black_pawns << 8);
+
+        Bitboard it = entry.passed[0];
+        while (it)
+            entry.score += passed_pawn[bitboard_bitscan_forward_pop(it)/8];
+
+        it = entry.passed[1];
+        while (it)
+            entry.score -= passed_pawn[7 - bitboard_bitscan_forward_pop(it)/8];
+
+        return entry;
+    }
+
 private:
-    void ray_movegen(MoveList& movelist) const
+    // Value of what move takes, en passant and promotions included. The
+    // captured piece is taken off occupancy.
+    Score see_victim(Move move, Bitboard &occupancy) const
+    {
+        using eval_tables::piece_values;
+
+        Score value = 0;
+        const Square to_sq = move.get_to();
+
+        if (move.get_type() == MoveSpecial::EnPassant)
+        {
+            value = piece_values[0];
+            bitboard_unset(occupancy, (turn == Color::White) ? to_sq - 8 : to_sq + 8);
+        }
+        else if (get_piece(to_sq) != Piece::None)
+        {
+            value = piece_values[static_cast<std::uint8_t>(get_piece(to_sq))];
+        }
+
+        if (move.get_type() == MoveSpecial::Promotion)
+            value += piece_values[static_cast<std::uint8_t>(move.get_promo())] - piece_values[0];
+
+        return value;
+    }
+
+    // Attackers of sq still in occupancy, with the sliders behind the pieces
+    // that have left it added
+    Bitboard see_xrays(Square sq, Bitboard occupancy, Bitboard attackers) const
+    {
+        const Bitboard target = Bitboard{1} << sq;
+
+        const Bitboard diag = get_bitboard(Piece::Bishop) | get_bitboard(Piece::Queen);
+        const Bitboard orth = get_bitboard(Piece::Rook) | get_bitboard(Piece::Queen);
+
+        attackers |= (bishop_attacks_setwise(target, occupancy) & diag) | (rook_attacks_setwise(target, occupancy) & orth);
+
+        return attackers & occupancy;
+    }
+
+    // The least valuable of the given attackers as a single bit, piece is set
+    // to its type. Empty if there are none.
+    Bitboard see_least_valuable(Bitboard attackers, Piece &piece) const
+    {
+        for (std::uint8_t p = 0; p < 6; p++)
+        {
+            const Bitboard b = attackers & pieces[p];
+
+            if (b != 0)
+            {
+                piece = static_cast<Piece>(p);
+                return b & (~b + 1);
+            }
+        }
+
+        return 0;
+    }
+
+    // Score of checkmate and stalemate, false if the position is neither
+    bool terminal_eval(const MoveList& movelist, int ply, Score &score) const
+    {
+        if (movelist.is_stalemate)
+        {
+            score = 0;
+            return true;
+        }
+
+        if (movelist.is_checkmate)
+        {
+            score = (turn == Color::White) ? mated_in(ply) : mate_in(ply);
+            return true;
+        }
+
+        return false;
+    }
+
+    // Middle and end game scores blended by game phase
+    static Score blend(Score mg, Score eg, int ph)
+    {
+        ph = std::min(ph, eval_tables::phase_max);
+        return (mg*ph + eg*(eval_tables::phase_max - ph))/eval_tables::phase_max;
+    }
+
+    // Blends the material and piece-square sums by game phase and adds the
+    // terms that are not kept incrementally
+    Score tapered_eval(Score mg, Score eg, int ph, PawnTable *pawn_table) const
+    {
+        using namespace eval_tables;
+
+        // Known endgames replace the evaluation
+        if (const endgame::Entry *e = endgame::probe(material_key))
+            return e->evaluate(endgame_position());
+
+        Score eval = blend(mg, eg, ph);
+
+        {
+            Bitboard white_pieces = colors[static_cast<std::uint8_t>(Color::White)] - get_bitboard(Color::White, Piece::Pawn);
+            Bitboard black_pieces = colors[static_cast<std::uint8_t>(Color::Black)] - get_bitboard(Color::Black, Piece::Pawn);
+
+            if ((bitboard_count(white_pieces) >= 2) && (bitboard_count(white_pieces) <= 4))
+            {
+                if(bitboard_count(get_bitboard(Color::White, Piece::Bishop)) == 2)
+                {
+                    eval += bishop_pair;
+                }
+            }
+
+            if ((bitboard_count(black_pieces) >= 2) && (bitboard_count(black_pieces) <= 4))
+            {
+                if(bitboard_count(get_bitboard(Color::Black, Piece::Bishop)) == 2)
+                {
+                    eval -= bishop_pair;
+                }
+            }
+        }
+
+        // Pawn structure, from the pawn table when one is given
+        PawnEntry pawns;
+
+        if (pawn_table == nullptr || !pawn_table->probe(pawn_key, pawns))
+        {
+            pawns = evaluate_pawns();
+
+            if (pawn_table != nullptr)
+                pawn_table->store(pawns);
+        }
+
+        eval += pawns.score;
+
+        eval += activity_eval(ph);
+
+        // Drawish material is scaled towards zero, judged for the side ahead
+        const std::uint8_t strong = (eval >= 0) ? 0 : 1;
+        int scale = endgame::material_scale(material_key, strong);
+
+        if (const endgame::ScaleEntry *s = endgame::probe_scale(material_key))
+            scale = std::min(scale, s->function(endgame_position(), strong));
+
+        if (scale != endgame::scale_normal)
+            eval = eval*scale/endgame::scale_normal;
+
+        return eval;
+    }
+
+    // Mobility and attacks on the enemy king zone from white's point of view,
+    // read off the attack maps of static_analysis. Squares defended by enemy
+    // pawns do not count as mobility, and king attacks fade with the phase.
+    Score activity_eval(int ph) const
+    {
+        using namespace eval_tables;
+
+        static_analysis();
+
+        Score mobility = 0;
+        Score king_attacks = 0;
+
+        for (std::uint8_t c = 0; c < 2; c++)
+        {
+            const std::array<Bitboard, 5> &attacks = attack_maps[c];
+            const std::array<Bitboard, 5> &enemy_attacks = attack_maps[1-c];
+
+            const Bitboard safe = ~colors[c] & ~enemy_attacks[0];
+            const Bitboard king = colors[1-c] & pieces[static_cast<std::uint8_t>(Piece::King)];
+            const Bitboard king_zone = king | enemy_attacks[4];
+
+            const Score m =
+                mobility_knight*bitboard_count(attacks[1] & safe) +
+                mobility_diagonal*bitboard_count(attacks[2] & safe) +
+                mobility_orthogonal*bitboard_count(attacks[3] & safe);
+
+            const Score k = king_zone_attack*bitboard_count((attacks[1] | attacks[2] | attacks[3]) & king_zone);
+
+            mobility += (c == 0) ? m : -m;
+            king_attacks += (c == 0) ? k : -k;
+        }
+
+        return mobility + king_attacks*std::min(ph, phase_max)/phase_max;
+    }
+
+    // Adds (sign 1) or removes (sign -1) a piece from the incremental sums,
+    // the pawn key and the material key
+    void incremental_update(Square sq, Tile tile, int sign)
+    {
+        if (tile.piece == Piece::None)
+            return;
+
+        const std::uint8_t p = static_cast<std::uint8_t>(tile.piece);
+
+        if (tile.piece == Piece::Pawn)
+            pawn_key ^= zobrist_pieces[static_cast<std::uint8_t>(tile.color)][p][sq];
+
+        if (tile.piece != Piece::King)
+        {
+            const std::uint64_t unit = endgame::material_unit(static_cast<std::uint8_t>(tile.color), p);
+            material_key = (sign > 0) ? material_key + unit : material_key - unit;
+        }
+
+        if (accumulator.active())
+        {
+            const std::uint8_t c = static_cast<std::uint8_t>(tile.color);
+
+            nnue::update(accumulator[0], nnue::feature(0, c, p, sq), sign);
+            nnue::update(accumulator[1], nnue::feature(1, c, p, sq), sign);
+        }
+
+        if (tile.color == Color::White)
+        {
+            psqt_mg += sign*eval_tables::psqt_mg[p][sq];
+            psqt_eg += sign*eval_tables::psqt_eg[p][sq];
+        }
+        else
+        {
+            psqt_mg -= sign*eval_tables::psqt_mg[p][sq ^ 56];
+            psqt_eg -= sign*eval_tables::psqt_eg[p][sq ^ 56];
+        }
+
+        phase += sign*eval_tables::phase_weights[p];
+    }
+
+    // Legal moves. With captures_only and not in check, only captures, en
+    // passant and promotions.
+    void ray_movegen(MoveList& movelist, bool captures_only = false) const
     {
         movelist.clear();
 
         static_analysis();
 
+        // Evasions are always generated in full
+        const bool only_tactical = captures_only && checkers == 0;
+
         Color their_color = Color::White;
         if (turn == Color::White)
             their_color = Color::Black;
@@ -996,6 +1522,10 @@ private:
 
             attacks &= ~colors[static_cast<std::uint8_t>(turn)];
 
+            // Pawn attacks are captures already, en passant included
+            if (only_tactical && tile.piece != Piece::Pawn)
+                attacks &= enemy_pieces;
+
             add_moves(movelist, from_square, attacks);
         }
 
@@ -1005,10 +1535,16 @@ private:
             movegen_rays[static_cast<std::uint8_t>(Ray::King)][their_king_square]
         };
 
-        add_moves(movelist, king_square, king_threats[0] & (~(enemy_threat | king_threats[1] | colors[static_cast<std::uint8_t>(turn)])));
+        Bitboard king_targets = king_threats[0] & (~(enemy_threat | king_threats[1] | colors[static_cast<std::uint8_t>(turn)]));
+        if (only_tactical)
+            king_targets &= enemy_pieces;
+
+        add_moves(movelist, king_square, king_targets);
 
-        // Pawn non-attacking moves
+        // Pawn non-attacking moves, only promotions when generating captures
         Bitboard pawns = get_bitboard(turn, Piece::Pawn);
+        if (only_tactical)
+            pawns &= (turn == Color::White) ? rank_8 >> 8 : rank_1 << 8;
         while (pawns)
         {
             const Square sq = bitboard_bitscan_forward_pop(pawns);
@@ -1088,7 +1624,7 @@ private:
             }
 
             // Generate castling moves
-            if (turn == Color::White)
+            if (!only_tactical && turn == Color::White)
             {
                 if (can_castle[static_cast<std::uint8_t>(Color::White)][0]) // King side
                 {
@@ -1112,7 +1648,7 @@ private:
                     }
                 }
             }
-            else if (turn == Color::Black)
+            else if (!only_tactical && turn == Color::Black)
             {
                 if (can_castle[static_cast<std::uint8_t>(Color::Black)][0]) // King side
                 {
@@ -1211,247 +1747,123 @@ private:
             bitboard_bitscan_forward(get_bitboard(their_color, Piece::King))
         };
 
-        Bitboard it_pieces = all_blockers;
-        while (it_pieces)
+        // Pawns on the back ranks attack nothing
+        const auto pawn_attacks = [&](Color c)
         {
-            const Square from_square = bitboard_bitscan_forward_pop(it_pieces);
-            const std::uint8_t from_x = from_square%8;
-            const std::uint8_t from_y = from_square/8;
+            return pawn_attacks_setwise(get_bitboard(c, Piece::Pawn) & ~(rank_1 | rank_8), c == Color::White);
+        };
 
-            const Tile tile = get_tile(from_x, from_y);
+        const auto orth_sliders = [&](Color c)
+        {
+            return get_bitboard(c, Piece::Rook) | get_bitboard(c, Piece::Queen);
+        };
 
-            Color them_color = Color::White;
-            if (tile.color == Color::White)
-                them_color = Color::Black;
+        const auto diag_sliders = [&](Color c)
+        {
+            return get_bitboard(c, Piece::Bishop) | get_bitboard(c, Piece::Queen);
+        };
 
-            Square their_king_square = king_squares[0];
-            if (tile.color == turn)
-                their_king_square = king_squares[1];
+        // Attack maps by piece type for both sides, kept for the evaluation
+        const std::uint8_t us = static_cast<std::uint8_t>(turn);
+        const std::uint8_t them = static_cast<std::uint8_t>(their_color);
 
-            Bitboard attacks = 0;
+        attack_maps[us][0] = pawn_attacks(turn);
+        attack_maps[us][1] = knight_attacks_setwise(get_bitboard(turn, Piece::Knight));
+        kogge_stone_attacks_split(orth_sliders(turn), diag_sliders(turn), all_blockers, attack_maps[us][3], attack_maps[us][2]);
+        attack_maps[us][4] = movegen_rays[static_cast<std::uint8_t>(Ray::King)][king_squares[0]];
 
-            switch (tile.piece)
-            {
-                case Piece::Pawn:
-                    {
-                        if (tile.color == Color::White)
-                        {
-                            attacks = movegen_rays[static_cast<std::uint8_t>(Ray::WhitePawnAttacks)][from_square];
-                        }
-                        else
-                        {
-                            attacks = movegen_rays[static_cast<std::uint8_t>(Ray::BlackPawnAttacks)][from_square];
-                        }
+        attack_maps[them][0] = pawn_attacks(their_color);
+        attack_maps[them][1] = knight_attacks_setwise(get_bitboard(their_color, Piece::Knight));
+        attack_maps[them][4] = movegen_rays[static_cast<std::uint8_t>(Ray::King)][king_squares[1]];
 
-                        if (tile.color == turn)
-                        {
-                            Bitboard target = colors[static_cast<std::uint8_t>(their_color)];
+        // Our attacks, pawns only where they can capture
+        {
+            Bitboard target = colors[static_cast<std::uint8_t>(their_color)];
 
-                            if (tile.color == turn && (ep_x != 9))
-                            {
-                                if (turn == Color::White)
-                                    bitboard_set(target, ep_x, 5);
-                                else
-                                    bitboard_set(target, ep_x, 2);
-                            }
+            if (ep_x != 9)
+            {
+                if (turn == Color::White)
+                    bitboard_set(target, ep_x, 5);
+                else
+                    bitboard_set(target, ep_x, 2);
+            }
 
-                            attacks &= target;
-                        }
-                    }
-                    break;
+            threat = (attack_maps[us][0] & target) | attack_maps[us][1] | attack_maps[us][2] | attack_maps[us][3];
+        }
 
-                case Piece::Knight:
-                    {
-                        attacks = movegen_rays[static_cast<std::uint8_t>(Ray::Knight)][from_square];
-                    }
-                    break;
+        // Their attacks. The attack maps see the board as it is, for the
+        // evaluation. For king moves their sliders see through our king, so
+        // it can't step back along a check.
+        {
+            kogge_stone_attacks_split(orth_sliders(their_color), diag_sliders(their_color), all_blockers, attack_maps[them][3], attack_maps[them][2]);
 
-                case Piece::Bishop:
-                    {
-                        for (std::uint8_t d = 0; d < 8; d+=2)
-                        {
-                            attacks |= movegen_rays[d][from_square];
+            Bitboard without_king = all_blockers;
+            bitboard_unset(without_king, king_squares[0]);
 
-                            Bitboard blockers = movegen_rays[d][from_square] & all_blockers;
+            Bitboard orth_xray, diag_xray;
+            kogge_stone_attacks_split(orth_sliders(their_color), diag_sliders(their_color), without_king, orth_xray, diag_xray);
 
-                            if (blockers != 0)
-                            {
-                                Square blocker_square = bitboard_bitscan(blockers, d);
-                                attacks &= ~movegen_rays[d][blocker_square];
-                            }
+            enemy_threat = attack_maps[them][0] | attack_maps[them][1] | orth_xray | diag_xray | attack_maps[them][4];
+        }
 
-                            if (bitboard_read(blockers, their_king_square))
-                            {
-                                Bitboard between =
-                                    movegen_rays[d][from_square] &
-                                    (~movegen_rays[d][their_king_square]);
-                                bitboard_unset(between, their_king_square);
-
-                                if (
-                                        bitboard_count(between & (colors[static_cast<std::uint8_t>(them_color)])) == 1 &&
-                                        bitboard_count(between & (colors[static_cast<std::uint8_t>(tile.color)])) == 0
-                                   )
-                                {
-                                    Square blocker_square = bitboard_bitscan(blockers, d);
-                                    bitboard_set(pinned, blocker_square);
-                                }
-
-                                if (bitboard_count(blockers & between) == 0)
-                                    check_blockers |= between;
-
-                                if (tile.color == their_color)
-                                {
-                                    // Extend threat beyond king
-                                    bitboard_unset(blockers, their_king_square);
-                                    if (blockers != 0)
-                                    {
-                                        Square blocker2 = bitboard_bitscan(blockers, d);
-
-                                        enemy_threat |= movegen_rays[d][from_square] & (~movegen_rays[d][blocker2]);
-                                    }
-                                    else
-                                    {
-                                        enemy_threat |= movegen_rays[d][from_square];
-                                    }
-                                }
-                            }
-                        }
-                    }
-                    break;
+        // Leaper checks
+        {
+            Bitboard king = 0;
+            bitboard_set(king, king_squares[0]);
 
-                case Piece::Rook:
-                    {
-                        for (std::uint8_t d = 1; d < 8; d+=2)
-                        {
-                            attacks |= movegen_rays[d][from_square];
+            checkers =
+                (get_bitboard(their_color, Piece::Pawn) & ~(rank_1 | rank_8) & pawn_attacks_setwise(king, turn == Color::White)) |
+                (get_bitboard(their_color, Piece::Knight) & movegen_rays[static_cast<std::uint8_t>(Ray::Knight)][king_squares[0]]);
+        }
 
-                            Bitboard blockers = movegen_rays[d][from_square] & all_blockers;
+        // Slider checks and pins, looking outward from both kings
+        check_blockers = 0;
+        pinned = 0;
 
-                            if (blockers != 0)
-                            {
-                                Square blocker_square = bitboard_bitscan(blockers, d);
-                                attacks &= ~movegen_rays[d][blocker_square];
-                            }
+        for (std::uint8_t k = 0; k < 2; k++)
+        {
+            const Color king_color = (k == 0) ? turn : their_color;
+            const Color slider_color = (k == 0) ? their_color : turn;
+            const Square king_square = king_squares[k];
 
-                            if (bitboard_read(blockers, their_king_square))
-                            {
-                                Bitboard between =
-                                    movegen_rays[d][from_square] &
-                                    (~movegen_rays[d][their_king_square]);
-                                bitboard_unset(between, their_king_square);
-
-                                if (
-                                        bitboard_count(between & (colors[static_cast<std::uint8_t>(them_color)])) == 1 &&
-                                        bitboard_count(between & (colors[static_cast<std::uint8_t>(tile.color)])) == 0
-                                   )
-                                {
-                                    Square blocker_square = bitboard_bitscan(blockers, d);
-                                    bitboard_set(pinned, blocker_square);
-                                }
-
-                                if (bitboard_count(blockers & between) == 0)
-                                    check_blockers |= between;
-
-                                if (tile.color == their_color)
-                                {
-                                    // Extend threat beyond king
-                                    bitboard_unset(blockers, their_king_square);
-                                    if (blockers != 0)
-                                    {
-                                        Square blocker2 = bitboard_bitscan(blockers, d);
-
-                                        enemy_threat |= movegen_rays[d][from_square] & (~movegen_rays[d][blocker2]);
-                                    }
-                                    else
-                                    {
-                                        enemy_threat |= movegen_rays[d][from_square];
-                                    }
-                                }
-                            }
-                        }
-                    }
-                    break;
+            // Diagonal directions are even, orthogonal odd
+            const std::array<Bitboard, 2> sliders =
+            {
+                diag_sliders(slider_color),
+                orth_sliders(slider_color)
+            };
 
-                case Piece::Queen:
-                    {
-                        for (std::uint8_t d = 0; d < 8; d++)
-                        {
-                            attacks |= movegen_rays[d][from_square];
+            for (std::uint8_t d = 0; d < 8; d++)
+            {
+                Bitboard blockers = movegen_rays[d][king_square] & all_blockers;
 
-                            Bitboard blockers = movegen_rays[d][from_square] & all_blockers;
+                if (blockers == 0)
+                    continue;
 
-                            if (blockers != 0)
-                            {
-                                Square blocker_square = bitboard_bitscan(blockers, d);
-                                attacks &= ~movegen_rays[d][blocker_square];
-                            }
+                const Square first = bitboard_bitscan(blockers, d);
 
-                            if (bitboard_read(blockers, their_king_square))
-                            {
-                                Bitboard between =
-                                    movegen_rays[d][from_square] &
-                                    (~movegen_rays[d][their_king_square]);
-                                bitboard_unset(between, their_king_square);
-
-                                if (
-                                        bitboard_count(between & (colors[static_cast<std::uint8_t>(them_color)])) == 1 &&
-                                        bitboard_count(between & (colors[static_cast<std::uint8_t>(tile.color)])) == 0
-                                   )
-                                {
-                                    Square blocker_square = bitboard_bitscan(blockers, d);
-                                    bitboard_set(pinned, blocker_square);
-                                }
-
-                                if (bitboard_count(blockers & between) == 0)
-                                    check_blockers |= between;
-
-                                if (tile.color == their_color)
-                                {
-                                    // Extend threat beyond king
-                                    bitboard_unset(blockers, their_king_square);
-                                    if (blockers != 0)
-                                    {
-                                        Square blocker2 = bitboard_bitscan(blockers, d);
-
-                                        enemy_threat |= movegen_rays[d][from_square] & (~movegen_rays[d][blocker2]);
-                                    }
-                                    else
-                                    {
-                                        enemy_threat |= movegen_rays[d][from_square];
-                                    }
-                                }
-                            }
-                        }
-                    }
-                    break;
+                if (bitboard_read(sliders[d%2], first))
+                {
+                    Bitboard between = movegen_rays[d][king_square] & (~movegen_rays[d][first]);
+                    bitboard_unset(between, first);
 
-                default:
-                    break;
-            }
+                    check_blockers |= between;
 
-            if (tile.color == turn)
-            {
-                threat |= attacks;
-            }
-            else
-            {
-                enemy_threat |= attacks;
+                    if (k == 0)
+                        bitboard_set(checkers, first);
 
-                if (bitboard_read(attacks, king_squares[0]))
-                {
-                    bitboard_set(checkers, from_square);
+                    continue;
                 }
-            }
-        }
 
-        // King threat
-        std::array<Bitboard, 2> king_threats =
-        {
-            movegen_rays[static_cast<std::uint8_t>(Ray::King)][king_squares[0]],
-            movegen_rays[static_cast<std::uint8_t>(Ray::King)][king_squares[1]]
-        };
+                if (!bitboard_read(colors[static_cast<std::uint8_t>(king_color)], first))
+                    continue;
 
-        enemy_threat |= king_threats[1];
+                bitboard_unset(blockers, first);
+
+                if (blockers != 0 && bitboard_read(sliders[d%2], bitboard_bitscan(blockers, d)))
+                    bitboard_set(pinned, first);
+            }
+        }
 
         bitboard_unset(check_blockers, king_squares[0]);
 
@@ -1514,6 +1926,21 @@ private:
     std::uint8_t repeatable_movecount = 0;
     std::uint16_t turn_number = 0;
 
+    // Incremental evaluation, material plus piece-square sums from white's
+    // point of view for middle and end game, kept up to date by set_tile
+    Score psqt_mg = 0;
+    Score psqt_eg = 0;
+    std::int16_t phase = 0;
+
+    // Zobrist hash of the pawns alone, for the pawn table
+    std::uint64_t pawn_key = 0;
+
+    // Piece counts, for the endgame tables
+    std::uint64_t material_key = 0;
+
+    // Network accumulators, kept up to date while a network is active
+    nnue::AccumulatorPair accumulator;
+
     // Zobrist
     mutable std::uint64_t zobrist_hash = 0;
 
@@ -1521,6 +1948,7 @@ private:
     mutable bool static_found = false;
     mutable Bitboard threat = 0;
     mutable Bitboard enemy_threat = 0;
+    mutable std::array<std::array<Bitboard, 5>, 2> attack_maps = {}; // By colour, then pawn, knight, diagonal, orthogonal and king
     mutable Bitboard checkers = 0;
     mutable Bitboard check_blockers = 0;
     mutable Bitboard pinned = 0;
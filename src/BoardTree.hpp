@@ -73,7 +73,7 @@ public:
         return n;
     }
 
-    double evaluation = 9999999;
+    Score evaluation = 9999999;
     Move bestmove = Move(Square{63},Square{63}, MoveSpecial::Promotion, Piece::Queen);
 
     // Info
@@ -0,0 +1,329 @@
+#ifndef DISTRIBUTED_PERFT_HPP
+#define DISTRIBUTED_PERFT_HPP
+
+#include "BoardTree.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Line based protocol between coordinator and workers over TCP:
+//   coordinator -> worker: "job <id> <depth> <fen>"
+//   worker -> coordinator: "result <id> <count>"
+//   coordinator -> worker: "quit"
+namespace perft_net
+{
+    inline bool send_line(int fd, const std::string &line)
+    {
+        const std::string s = line + '\n';
+        std::size_t sent = 0;
+
+        while (sent < s.size())
+        {
+            const ssize_t n = send(fd, s.data()+sent, s.size()-sent, MSG_NOSIGNAL);
+
+            if (n <= 0)
+                return false;
+
+            sent += n;
+        }
+
+        return true;
+    }
+
+    // Reads one line, buffer keeps what was read past the newline
+    inline bool recv_line(int fd, std::string &buffer, std::string &line)
+    {
+        std::size_t pos;
+
+        while ((pos = buffer.find('\n')) == std::string::npos)
+        {
+            char chunk[512];
+            const ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+
+            if (n <= 0)
+                return false;
+
+            buffer.append(chunk, n);
+        }
+
+        line = buffer.substr(0, pos);
+        buffer.erase(0, pos+1);
+
+        return true;
+    }
+}
+
+class PerftCoordinator
+{
+public:
+    // A worker that sends no result for job_timeout seconds is dropped and
+    // its job given to another, so it must exceed the longest job
+    PerftCoordinator(const Board &root, std::uint8_t depth_, std::uint8_t split_ply_, int job_timeout_ = 600)
+        : depth(depth_), job_timeout(job_timeout_)
+    {
+        if (split_ply_ > depth)
+            split_ply_ = depth;
+
+        // Identical positions have identical subtrees, so transpositions at
+        // the split ply become one job with a multiplicity
+        std::map<std::string, std::uint64_t> positions;
+        split(root, split_ply_, positions);
+
+        for (const auto &p : positions)
+        {
+            jobs.push_back(Job{jobs.size(), p.first, p.second});
+            queue.push_back(jobs.size()-1);
+        }
+
+        split_ply = split_ply_;
+    }
+
+    // Serves workers until every job has a result, then returns the total
+    std::uint64_t run(std::uint16_t port)
+    {
+        listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+        const int yes = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+
+        if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listen_fd, 64) != 0)
+        {
+            std::cerr << "Could not listen on port " << port << std::endl;
+            close(listen_fd);
+            return 0;
+        }
+
+        std::cout << jobs.size() << " jobs at ply " << int{split_ply} << ", listening on port " << port << std::endl;
+
+        std::thread accept_thread(&PerftCoordinator::accept_loop, this);
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done_cv.wait(lock, [&]() { return done == jobs.size(); });
+            finished = true;
+        }
+        queue_cv.notify_all();
+
+        // Unblock accept()
+        shutdown(listen_fd, SHUT_RDWR);
+        close(listen_fd);
+        accept_thread.join();
+
+        for (std::thread &t : worker_threads)
+            t.join();
+
+        std::uint64_t total = 0;
+        for (const Job &job : jobs)
+            total += job.result * job.multiplicity;
+
+        return total;
+    }
+
+private:
+    struct Job
+    {
+        std::size_t id;
+        std::string fen;
+        std::uint64_t multiplicity;
+        std::uint64_t result = 0;
+    };
+
+    void split(const Board &b, std::uint8_t ply, std::map<std::string, std::uint64_t> &positions)
+    {
+        if (ply == 0)
+        {
+            // Drop the move counters, they do not affect the subtree
+            std::string fen = b.get_fen();
+            fen = fen.substr(0, fen.rfind(' '));
+            fen = fen.substr(0, fen.rfind(' '));
+
+            positions[fen]++;
+            return;
+        }
+
+        MoveList moves;
+        b.get_moves(moves);
+
+        for (const Move &m : moves)
+            split(Board(b, m), ply-1, positions);
+    }
+
+    void accept_loop()
+    {
+        while (1)
+        {
+            const int fd = accept(listen_fd, nullptr, nullptr);
+
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (finished)
+            {
+                if (fd >= 0)
+                {
+                    perft_net::send_line(fd, "quit");
+                    close(fd);
+                }
+                return;
+            }
+
+            if (fd < 0)
+                continue;
+
+            worker_threads.emplace_back(&PerftCoordinator::serve_worker, this, fd, worker_threads.size());
+        }
+    }
+
+    void serve_worker(int fd, std::size_t worker_id)
+    {
+        std::string buffer;
+
+        // A worker that hangs without closing its socket would otherwise
+        // hold its job forever
+        timeval timeout{};
+        timeout.tv_sec = job_timeout;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        while (1)
+        {
+            std::size_t job_id;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                queue_cv.wait(lock, [&]() { return finished || !queue.empty(); });
+
+                if (finished)
+                    break;
+
+                job_id = queue.front();
+                queue.pop_front();
+            }
+
+            const Job &job = jobs.at(job_id);
+
+            std::string line;
+            bool ok = perft_net::send_line(fd, "job " + std::to_string(job.id) + ' ' + std::to_string(depth - split_ply) + ' ' + job.fen);
+            ok = ok && perft_net::recv_line(fd, buffer, line);
+
+            std::istringstream iss(line);
+            std::string cmd;
+            std::size_t id = 0;
+            std::uint64_t count = 0;
+            ok = ok && (iss >> cmd >> id >> count) && cmd == "result" && id == job_id;
+
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (!ok)
+            {
+                // Worker is gone or timed out, give the job to someone else
+                std::cout << "Worker " << worker_id << " lost, re-queueing job " << job_id << std::endl;
+                queue.push_back(job_id);
+                queue_cv.notify_one();
+                close(fd);
+                return;
+            }
+
+            jobs.at(job_id).result = count;
+            done++;
+
+            if (done == jobs.size())
+                done_cv.notify_all();
+        }
+
+        perft_net::send_line(fd, "quit");
+        close(fd);
+    }
+
+    std::uint8_t depth;
+    std::uint8_t split_ply;
+    int job_timeout;
+
+    std::vector<Job> jobs;
+    std::deque<std::size_t> queue;
+    std::size_t done = 0;
+    bool finished = false;
+
+    std::mutex mutex;
+    std::condition_variable queue_cv;
+    std::condition_variable done_cv;
+
+    int listen_fd = -1;
+    std::vector<std::thread> worker_threads;
+};
+
+class PerftWorker
+{
+public:
+    // Connects to the coordinator and serves jobs until told to quit,
+    // returns the number of jobs completed
+    std::uint64_t run(const std::string &host, std::uint16_t port)
+    {
+        const int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+
+        if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 ||
+                connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+        {
+            std::cerr << "Could not connect to " << host << ':' << port << std::endl;
+            close(fd);
+            return 0;
+        }
+
+        std::uint64_t completed = 0;
+        std::string buffer;
+        std::string line;
+        MoveList moves;
+
+        while (perft_net::recv_line(fd, buffer, line))
+        {
+            std::istringstream iss(line);
+            std::string cmd;
+            iss >> cmd;
+
+            if (cmd != "job")
+                break;
+
+            std::size_t id;
+            int d;
+            iss >> id >> d;
+
+            std::string fen;
+            std::getline(iss >> std::ws, fen);
+
+            BoardTree tree{Board(fen)};
+            const std::uint64_t count = tree.depth(moves, d);
+
+            if (!perft_net::send_line(fd, "result " + std::to_string(id) + ' ' + std::to_string(count)))
+                break;
+
+            completed++;
+        }
+
+        close(fd);
+
+        return completed;
+    }
+};
+
+#endif
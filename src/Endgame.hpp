@@ -0,0 +1,533 @@
+#ifndef ENDGAME_HPP
+#define ENDGAME_HPP
+
+#include "Bitboard.hpp"
+#include "evaluation.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Specialised evaluation of known endgames, looked up by material signature.
+//
+// The material key holds the piece counts, 4 bits per colour and piece type
+// with kings left out, so it is updated by adding and subtracting and never
+// collides. Exact signatures (KPK, KRKP, ...) map to evaluation functions, a
+// lone king against mating material is recognised generically (KXK), and
+// scale factors pull drawish material towards zero.
+namespace endgame
+{
+    constexpr Score known_win = 10000;
+
+    // Scale factors are out of scale_normal
+    constexpr int scale_normal = 64;
+
+    constexpr std::uint64_t material_unit(std::uint8_t color, std::uint8_t piece)
+    {
+        return std::uint64_t{1} << (4*(color*5 + piece));
+    }
+
+    constexpr int material_count(std::uint64_t key, std::uint8_t color, std::uint8_t piece)
+    {
+        return (key >> (4*(color*5 + piece))) & 0xF;
+    }
+
+    // Counts of one side, and of the pieces other than pawns
+    constexpr std::uint64_t side_mask(std::uint8_t color)
+    {
+        return std::uint64_t{0xFFFFF} << (20*color);
+    }
+
+    constexpr std::uint64_t non_pawn_mask = ~(material_unit(0, 0)*0xF | material_unit(1, 0)*0xF);
+
+    // Key of a signature such as "KRKP", white's pieces first. swap gives the
+    // same material with the colours the other way round.
+    inline std::uint64_t material_key(const std::string &code, bool swap = false)
+    {
+        std::uint64_t key = 0;
+        int color = -1;
+
+        for (char c : code)
+        {
+            if (c == 'K')
+            {
+                color++;
+                continue;
+            }
+
+            const std::string order = "PNBRQ";
+            const std::uint8_t p = order.find(c);
+            key += material_unit(swap ? 1-color : color, p);
+        }
+
+        return key;
+    }
+
+    // Non-pawn material of one side in centipawns
+    constexpr Score non_pawn_material(std::uint64_t key, std::uint8_t color)
+    {
+        Score npm = 0;
+
+        for (std::uint8_t p = 1; p < 5; p++)
+            npm += material_count(key, color, p)*eval_tables::piece_values[p];
+
+        return npm;
+    }
+
+    // The bitboards an endgame function looks at, by colour and piece
+    struct Position
+    {
+        std::array<std::array<Bitboard, 6>, 2> pieces;
+        Color turn;
+
+        Square square(std::uint8_t color, Piece piece) const
+        {
+            return bitboard_bitscan_forward(pieces[color][static_cast<std::uint8_t>(piece)]);
+        }
+    };
+
+    // King distance between two squares
+    inline int distance(Square a, Square b)
+    {
+        return std::max(std::abs(a%8 - b%8), std::abs(a/8 - b/8));
+    }
+
+    // Bonus for the weak king being near the edge, and for the kings being close
+    inline Score push_to_edge(Square sq)
+    {
+        const int dx = std::min(sq%8, 7 - sq%8);
+        const int dy = std::min(sq/8, 7 - sq/8);
+        return 90 - 20*std::min(dx, dy) - 10*(dx + dy);
+    }
+
+    inline Score push_close(Square a, Square b)
+    {
+        return 140 - 20*distance(a, b);
+    }
+
+    // King and pawn against king bitbase, built by retrograde analysis the
+    // first time it is probed. Positions are seen with the pawn side as
+    // white, the pawn on files a-d and ranks 2-7.
+    namespace kpk_bitbase
+    {
+        constexpr std::size_t size = 2*24*64*64;
+
+        constexpr std::size_t index(bool strong_to_move, Square strong_king, Square weak_king, Square pawn)
+        {
+            return strong_to_move + 2*(weak_king + 64*(strong_king + 64*((pawn/8 - 1)*4 + pawn%8)));
+        }
+
+        enum Result : std::uint8_t
+        {
+            Invalid,
+            Unknown,
+            Draw,
+            Win
+        };
+
+        inline bool pawn_attacks(Square pawn, Square sq)
+        {
+            return sq/8 == pawn/8 + 1 && std::abs(sq%8 - pawn%8) == 1;
+        }
+
+        inline Result classify(bool strong_to_move, Square strong_king, Square weak_king, Square pawn)
+        {
+            if (strong_king == weak_king || strong_king == pawn || weak_king == pawn || distance(strong_king, weak_king) <= 1)
+                return Invalid;
+
+            if (strong_to_move)
+            {
+                // The weak king cannot be left in check
+                if (pawn_attacks(pawn, weak_king))
+                    return Invalid;
+
+                // Promotes without the queen being taken
+                const Square queening = pawn + 8;
+                if (pawn/8 == 6 && queening != strong_king && queening != weak_king &&
+                        (distance(weak_king, queening) > 1 || distance(strong_king, queening) == 1))
+                    return Win;
+
+                return Unknown;
+            }
+
+            // Stalemate, or the pawn is taken
+            bool can_move = false;
+
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    const int x = weak_king%8 + dx;
+                    const int y = weak_king/8 + dy;
+
+                    if ((dx == 0 && dy == 0) || x < 0 || x > 7 || y < 0 || y > 7)
+                        continue;
+
+                    const Square to = y*8 + x;
+
+                    if (distance(to, strong_king) <= 1 || pawn_attacks(pawn, to))
+                        continue;
+
+                    if (to == pawn)
+                        return Draw;
+
+                    can_move = true;
+                }
+            }
+
+            return can_move ? Unknown : Draw;
+        }
+
+        inline std::vector<bool> generate()
+        {
+            std::vector<Result> db(size);
+
+            for (std::uint8_t pawn = 8; pawn < 56; pawn++)
+            {
+                if (pawn%8 >= 4)
+                    continue;
+
+                for (Square sk = 0; sk < 64; sk++)
+                    for (Square wk = 0; wk < 64; wk++)
+                        for (bool stm : {false, true})
+                            db[index(stm, sk, wk, pawn)] = classify(stm, sk, wk, pawn);
+            }
+
+            bool changed = true;
+
+            while (changed)
+            {
+                changed = false;
+
+                for (std::uint8_t pawn = 8; pawn < 56; pawn++)
+                {
+                    if (pawn%8 >= 4)
+                        continue;
+
+                    for (Square sk = 0; sk < 64; sk++)
+                    {
+                        for (Square wk = 0; wk < 64; wk++)
+                        {
+                            for (bool stm : {false, true})
+                            {
+                                Result &r = db[index(stm, sk, wk, pawn)];
+
+                                if (r != Unknown)
+                                    continue;
+
+                                // The side to move picks its best successor, the
+                                // other side's result of each
+                                const Result good = stm ? Win : Draw;
+                                const Result bad = stm ? Draw : Win;
+                                bool all_bad = true;
+                                bool found_good = false;
+
+                                const auto visit = [&](std::size_t i)
+                                {
+                                    if (db[i] == good)
+                                        found_good = true;
+                                    else if (db[i] != bad && db[i] != Invalid)
+                                        all_bad = false;
+                                };
+
+                                const Square king = stm ? sk : wk;
+
+                                for (int dy = -1; dy <= 1; dy++)
+                                {
+                                    for (int dx = -1; dx <= 1; dx++)
+                                    {
+                                        const int x = king%8 + dx;
+                                        const int y = king/8 + dy;
+
+                                        if ((dx == 0 && dy == 0) || x < 0 || x > 7 || y < 0 || y > 7)
+                                            continue;
+
+                                        const Square to = y*8 + x;
+                                        visit(stm ? index(false, to, wk, pawn) : index(true, sk, to, pawn));
+                                    }
+                                }
+
+                                // Pawn pushes, promotion is settled by classify
+                                if (stm && pawn/8 < 6)
+                                {
+                                    const Square single = pawn + 8;
+
+                                    if (single != sk && single != wk)
+                                    {
+                                        visit(index(false, sk, wk, single));
+
+                                        const Square twice = pawn + 16;
+                                        if (pawn/8 == 1 && twice != sk && twice != wk)
+                                            visit(index(false, sk, wk, twice));
+                                    }
+                                }
+
+                                if (found_good)
+                                    r = good;
+                                else if (all_bad)
+                                    r = bad;
+                                else
+                                    continue;
+
+                                changed = true;
+                            }
+                        }
+                    }
+                }
+            }
+
+            std::vector<bool> wins(size);
+
+            for (std::size_t i = 0; i < size; i++)
+                wins[i] = (db[i] == Win);
+
+            return wins;
+        }
+
+        // Squares relative to the pawn side, true if it wins
+        inline bool probe(bool strong_to_move, Square strong_king, Square weak_king, Square pawn)
+        {
+            static const std::vector<bool> wins = generate();
+
+            if (pawn%8 >= 4)
+            {
+                strong_king ^= 7;
+                weak_king ^= 7;
+                pawn ^= 7;
+            }
+
+            return wins[index(strong_to_move, strong_king, weak_king, pawn)];
+        }
+    }
+
+    // Evaluation functions score from the strong side's point of view
+    inline Score draw(const Position&, std::uint8_t)
+    {
+        return 0;
+    }
+
+    // Lone king against mating material, drive it to the edge
+    inline Score kxk(const Position &pos, std::uint8_t strong)
+    {
+        const std::uint8_t weak = 1-strong;
+        const Square strong_king = pos.square(strong, Piece::King);
+        const Square weak_king = pos.square(weak, Piece::King);
+
+        Score score = push_to_edge(weak_king) + push_close(strong_king, weak_king);
+
+        for (std::uint8_t p = 0; p < 5; p++)
+            score += eval_tables::piece_values[p]*bitboard_count(pos.pieces[strong][p]);
+
+        const Bitboard bishops = pos.pieces[strong][static_cast<std::uint8_t>(Piece::Bishop)];
+        constexpr Bitboard dark_squares = 0xAA55AA55AA55AA55;
+
+        if (pos.pieces[strong][static_cast<std::uint8_t>(Piece::Queen)] ||
+                pos.pieces[strong][static_cast<std::uint8_t>(Piece::Rook)] ||
+                (bishops && pos.pieces[strong][static_cast<std::uint8_t>(Piece::Knight)]) ||
+                ((bishops & dark_squares) && (bishops & ~dark_squares)))
+            score += known_win;
+
+        return score;
+    }
+
+    // Bishop and knight mate, the lone king has to go to a corner of the
+    // bishop's colour
+    inline Score kbnk(const Position &pos, std::uint8_t strong)
+    {
+        const Square strong_king = pos.square(strong, Piece::King);
+        const Square weak_king = pos.square(1-strong, Piece::King);
+        const Square bishop = pos.square(strong, Piece::Bishop);
+
+        // a1 is dark
+        const bool dark = (bishop%8 + bishop/8)%2 == 0;
+        const int corner = dark ?
+            std::min(distance(weak_king, 0), distance(weak_king, 63)) :
+            std::min(distance(weak_king, 7), distance(weak_king, 56));
+
+        return known_win + push_close(strong_king, weak_king) + 60*(7 - corner);
+    }
+
+    inline Score kpk(const Position &pos, std::uint8_t strong)
+    {
+        // Flip so that the pawn side plays up the board
+        const Square flip = strong == 0 ? 0 : 56;
+        const Square strong_king = pos.square(strong, Piece::King) ^ flip;
+        const Square weak_king = pos.square(1-strong, Piece::King) ^ flip;
+        const Square pawn = pos.square(strong, Piece::Pawn) ^ flip;
+
+        if (!kpk_bitbase::probe(static_cast<std::uint8_t>(pos.turn) == strong, strong_king, weak_king, pawn))
+            return 0;
+
+        return known_win + eval_tables::piece_values[0] + 10*(pawn/8);
+    }
+
+    // Rook against pawn. Won when the strong king gets in front of the pawn or
+    // the weak king is too far away, otherwise a race for the queening square.
+    inline Score krkp(const Position &pos, std::uint8_t strong)
+    {
+        // Flip so that the pawn plays down the board
+        const Square flip = strong == 0 ? 0 : 56;
+        const Square strong_king = pos.square(strong, Piece::King) ^ flip;
+        const Square weak_king = pos.square(1-strong, Piece::King) ^ flip;
+        const Square rook = pos.square(strong, Piece::Rook) ^ flip;
+        const Square pawn = pos.square(1-strong, Piece::Pawn) ^ flip;
+
+        const Square queening = pawn%8;
+        const bool weak_to_move = static_cast<std::uint8_t>(pos.turn) != strong;
+        const Score rook_value = eval_tables::piece_values[3];
+
+        if (strong_king%8 == pawn%8 && strong_king < pawn)
+            return rook_value - distance(strong_king, pawn);
+
+        if (distance(weak_king, pawn) >= 3 + weak_to_move && distance(weak_king, rook) >= 3)
+            return rook_value - distance(strong_king, pawn);
+
+        if (weak_king/8 <= 2 && distance(weak_king, pawn) == 1 && strong_king/8 >= 4 &&
+                distance(strong_king, pawn) > 2 + !weak_to_move)
+            return 80 - 8*distance(strong_king, pawn);
+
+        const Square next = pawn - 8;
+        return 200 - 8*(distance(strong_king, next) - distance(weak_king, next) - distance(pawn, queening));
+    }
+
+    // Bishops on opposite colours with only pawns besides are drawish
+    inline int opposite_bishops(const Position &pos, std::uint8_t)
+    {
+        constexpr Bitboard dark_squares = 0xAA55AA55AA55AA55;
+
+        const Bitboard white = pos.pieces[0][static_cast<std::uint8_t>(Piece::Bishop)];
+        const Bitboard black = pos.pieces[1][static_cast<std::uint8_t>(Piece::Bishop)];
+
+        if (((white & dark_squares) != 0) == ((black & dark_squares) != 0))
+            return scale_normal;
+
+        const int pawn_difference = std::abs(bitboard_count(pos.pieces[0][0]) - bitboard_count(pos.pieces[1][0]));
+
+        return pawn_difference <= 1 ? scale_normal/4 : scale_normal/2;
+    }
+
+    using EvalFunction = Score (*)(const Position&, std::uint8_t);
+    using ScaleFunction = int (*)(const Position&, std::uint8_t);
+
+    struct Entry
+    {
+        EvalFunction function;
+        std::uint8_t strong;
+
+        // From white's point of view
+        Score evaluate(const Position &pos) const
+        {
+            const Score score = function(pos, strong);
+            return strong == 0 ? score : -score;
+        }
+    };
+
+    struct ScaleEntry
+    {
+        ScaleFunction function;
+    };
+
+    struct Tables
+    {
+        std::unordered_map<std::uint64_t, Entry> evaluations;
+        std::unordered_map<std::uint64_t, ScaleEntry> scales; // Keyed by the non-pawn material
+
+        Tables()
+        {
+            add("KK", draw);
+            add("KNK", draw);
+            add("KBK", draw);
+            add("KNNK", draw);
+            add("KBNK", kbnk);
+            add("KPK", kpk);
+            add("KRKP", krkp);
+
+            scales[material_key("KBKB")] = {opposite_bishops};
+        }
+
+        // Both colours of a signature, the first king being the strong side
+        void add(const std::string &code, EvalFunction function)
+        {
+            evaluations[material_key(code)] = {function, 0};
+            evaluations[material_key(code, true)] = {function, 1};
+        }
+    };
+
+    inline const Tables tables;
+
+    // Total number of pieces other than kings
+    constexpr int piece_count(std::uint64_t key)
+    {
+        // Pairs of nibbles summed into bytes, then the bytes summed
+        const std::uint64_t bytes = (key & 0x0F0F0F0F0F) + ((key >> 4) & 0x0F0F0F0F0F);
+        return ((bytes*0x0101010101) >> 32) & 0xFF;
+    }
+
+    // Specialised evaluation for the material, or nullptr
+    inline const Entry* probe(std::uint64_t key)
+    {
+        static const Entry kxk_white = {kxk, 0};
+        static const Entry kxk_black = {kxk, 1};
+
+        // Every exact signature has at most two pieces
+        if (piece_count(key) <= 2)
+        {
+            const auto it = tables.evaluations.find(key);
+
+            if (it != tables.evaluations.end())
+                return &it->second;
+        }
+
+        if ((key & side_mask(1)) == 0 && non_pawn_material(key, 0) >= eval_tables::piece_values[3])
+            return &kxk_white;
+
+        if ((key & side_mask(0)) == 0 && non_pawn_material(key, 1) >= eval_tables::piece_values[3])
+            return &kxk_black;
+
+        return nullptr;
+    }
+
+    // Scale function for the material, or nullptr
+    inline const ScaleEntry* probe_scale(std::uint64_t key)
+    {
+        if (piece_count(key & non_pawn_mask) > 2)
+            return nullptr;
+
+        const auto it = tables.scales.find(key & non_pawn_mask);
+        return (it != tables.scales.end()) ? &it->second : nullptr;
+    }
+
+    // Scale from the material alone: a side without pawns that is at most a
+    // minor piece up can hardly win
+    inline int material_scale(std::uint64_t key, std::uint8_t strong)
+    {
+        if (material_count(key, strong, 0) != 0)
+            return scale_normal;
+
+        const Score npm_strong = non_pawn_material(key, strong);
+        const Score npm_weak = non_pawn_material(key, 1-strong);
+
+        if (npm_strong - npm_weak > eval_tables::piece_values[2])
+            return scale_normal;
+
+        if (npm_strong < eval_tables::piece_values[3])
+            return 0;
+
+        return npm_weak <= eval_tables::piece_values[2] ? 4 : 14;
+    }
+
+    // Whether any of the above may apply, which the lazy evaluation's margin
+    // does not account for
+    inline bool special(std::uint64_t key)
+    {
+        return material_count(key, 0, 0) == 0 || material_count(key, 1, 0) == 0 ||
+            probe(key) != nullptr || probe_scale(key) != nullptr;
+    }
+}
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef EVAL_CACHE_HPP
+#define EVAL_CACHE_HPP
+
+#include "evaluation.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Fixed size cache of static evaluations keyed by zobrist hash. Each entry is
+// a single 64 bit word, the upper 48 bits of the key and the 16 bit score, so
+// it is read and written atomically without locks. A torn or overwritten entry
+// simply fails the key check.
+class EvalCache
+{
+public:
+    EvalCache(std::size_t mb = 16)
+    {
+        resize(mb);
+    }
+
+    // Size in megabytes, rounded down to a power of two entries. 0 disables.
+    void resize(std::size_t mb)
+    {
+        std::size_t n = 0;
+
+        if (mb != 0)
+        {
+            n = 1;
+            while (n*2*sizeof(std::uint64_t) <= mb*1024*1024)
+                n *= 2;
+        }
+
+        entries.reset(n ? new std::atomic<std::uint64_t>[n] : nullptr);
+        mask = n ? n-1 : 0;
+        size = n;
+
+        clear();
+    }
+
+    void clear()
+    {
+        for (std::size_t i = 0; i < size; i++)
+            entries[i].store(0, std::memory_order_relaxed);
+    }
+
+    bool enabled() const
+    {
+        return size != 0;
+    }
+
+    bool probe(std::uint64_t key, Score &score)
+    {
+        if (size == 0)
+            return false;
+
+        const std::uint64_t e = entries[key & mask].load(std::memory_order_relaxed);
+
+        if (e == 0 || (e & key_mask) != (key & key_mask))
+            return false;
+
+        score = static_cast<std::int16_t>(e & ~key_mask);
+
+        return true;
+    }
+
+    void store(std::uint64_t key, Score score)
+    {
+        if (size == 0)
+            return;
+
+        const std::uint64_t e = (key & key_mask) | static_cast<std::uint16_t>(score);
+        entries[key & mask].store(e, std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr std::uint64_t key_mask = 0xFFFFFFFFFFFF0000;
+
+    std::unique_ptr<std::atomic<std::uint64_t>[]> entries;
+    std::size_t mask = 0;
+    std::size_t size = 0;
+};
+
+#endif
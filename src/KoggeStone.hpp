@@ -0,0 +1,202 @@
+#ifndef KOGGE_STONE_HPP
+#define KOGGE_STONE_HPP
+
+#include "Bitboard.hpp"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Set-wise slider attacks with Kogge-Stone occluded fills. Instead of looking
+// up a ray and bitscanning for the blocker per piece and direction, all
+// sliders of a kind are filled at once, so the result is the union of their
+// attacks. With AVX2 four directions are filled in one register.
+
+constexpr Bitboard file_a = 0x0101010101010101;
+constexpr Bitboard file_b = file_a << 1;
+constexpr Bitboard file_g = file_a << 6;
+constexpr Bitboard file_h = file_a << 7;
+
+constexpr Bitboard not_a = ~file_a;
+constexpr Bitboard not_h = ~file_h;
+
+constexpr Bitboard rank_1 = 0x00000000000000FF;
+constexpr Bitboard rank_8 = 0xFF00000000000000;
+
+// Attacks in direction S (positive is a left shift), up to and including the
+// first blocker. wrap masks out squares that wrapped around the board edge.
+template <int S>
+constexpr Bitboard kogge_stone_fill(Bitboard gen, Bitboard empty, Bitboard wrap)
+{
+    const auto sh = [](Bitboard b, int n) -> Bitboard
+    {
+        return (n > 0) ? (b << n) : (b >> -n);
+    };
+
+    Bitboard pro = empty & wrap;
+
+    gen |= pro & sh(gen, S);
+    pro &= sh(pro, S);
+    gen |= pro & sh(gen, 2*S);
+    pro &= sh(pro, 2*S);
+    gen |= pro & sh(gen, 4*S);
+
+    return sh(gen, S) & wrap;
+}
+
+// Union of attacks from orthogonal sliders (rooks and queens) and diagonal
+// sliders (bishops and queens)
+constexpr Bitboard kogge_stone_attacks_scalar(Bitboard orth, Bitboard diag, Bitboard occ)
+{
+    const Bitboard empty = ~occ;
+
+    return
+        kogge_stone_fill<8>(orth, empty, ~Bitboard{0}) |
+        kogge_stone_fill<-8>(orth, empty, ~Bitboard{0}) |
+        kogge_stone_fill<1>(orth, empty, not_a) |
+        kogge_stone_fill<-1>(orth, empty, not_h) |
+        kogge_stone_fill<9>(diag, empty, not_a) |
+        kogge_stone_fill<-9>(diag, empty, not_h) |
+        kogge_stone_fill<7>(diag, empty, not_h) |
+        kogge_stone_fill<-7>(diag, empty, not_a);
+}
+
+#ifdef __AVX2__
+// Lanes are N, E, NE, NW going up the board and S, W, SW, SE going down.
+// Returns the up and down attacks combined, orthogonal in the low 128 bits
+// and diagonal in the high 128 bits.
+inline __m256i kogge_stone_lanes_avx2(Bitboard orth, Bitboard diag, Bitboard occ)
+{
+    const __m256i empty = _mm256_set1_epi64x(~occ);
+    const __m256i gen_init = _mm256_setr_epi64x(orth, orth, diag, diag);
+
+    const __m256i s1 = _mm256_setr_epi64x(8, 1, 9, 7);
+    const __m256i s2 = _mm256_slli_epi64(s1, 1);
+    const __m256i s4 = _mm256_slli_epi64(s1, 2);
+
+    const __m256i up_wrap = _mm256_setr_epi64x(~Bitboard{0}, not_a, not_a, not_h);
+    const __m256i down_wrap = _mm256_setr_epi64x(~Bitboard{0}, not_h, not_h, not_a);
+
+    __m256i gen = gen_init;
+    __m256i pro = _mm256_and_si256(empty, up_wrap);
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_sllv_epi64(gen, s1)));
+    pro = _mm256_and_si256(pro, _mm256_sllv_epi64(pro, s1));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_sllv_epi64(gen, s2)));
+    pro = _mm256_and_si256(pro, _mm256_sllv_epi64(pro, s2));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_sllv_epi64(gen, s4)));
+    const __m256i up = _mm256_and_si256(_mm256_sllv_epi64(gen, s1), up_wrap);
+
+    gen = gen_init;
+    pro = _mm256_and_si256(empty, down_wrap);
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srlv_epi64(gen, s1)));
+    pro = _mm256_and_si256(pro, _mm256_srlv_epi64(pro, s1));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srlv_epi64(gen, s2)));
+    pro = _mm256_and_si256(pro, _mm256_srlv_epi64(pro, s2));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srlv_epi64(gen, s4)));
+    const __m256i down = _mm256_and_si256(_mm256_srlv_epi64(gen, s1), down_wrap);
+
+    return _mm256_or_si256(up, down);
+}
+
+inline Bitboard kogge_stone_attacks_avx2(Bitboard orth, Bitboard diag, Bitboard occ)
+{
+    // Union of the eight directions
+    const __m256i all = kogge_stone_lanes_avx2(orth, diag, occ);
+    __m128i x = _mm_or_si128(_mm256_castsi256_si128(all), _mm256_extracti128_si256(all, 1));
+    x = _mm_or_si128(x, _mm_unpackhi_epi64(x, x));
+
+    return _mm_cvtsi128_si64(x);
+}
+
+inline void kogge_stone_attacks_split_avx2(Bitboard orth, Bitboard diag, Bitboard occ, Bitboard &orth_attacks, Bitboard &diag_attacks)
+{
+    const __m256i all = kogge_stone_lanes_avx2(orth, diag, occ);
+    const __m128i o = _mm256_castsi256_si128(all);
+    const __m128i d = _mm256_extracti128_si256(all, 1);
+
+    orth_attacks = _mm_cvtsi128_si64(_mm_or_si128(o, _mm_unpackhi_epi64(o, o)));
+    diag_attacks = _mm_cvtsi128_si64(_mm_or_si128(d, _mm_unpackhi_epi64(d, d)));
+}
+#endif
+
+inline Bitboard kogge_stone_attacks(Bitboard orth, Bitboard diag, Bitboard occ)
+{
+#ifdef __AVX2__
+    return kogge_stone_attacks_avx2(orth, diag, occ);
+#else
+    return kogge_stone_attacks_scalar(orth, diag, occ);
+#endif
+}
+
+// Same as kogge_stone_attacks, with the orthogonal and diagonal attacks kept
+// apart at no extra cost
+inline void kogge_stone_attacks_split(Bitboard orth, Bitboard diag, Bitboard occ, Bitboard &orth_attacks, Bitboard &diag_attacks)
+{
+#ifdef __AVX2__
+    kogge_stone_attacks_split_avx2(orth, diag, occ, orth_attacks, diag_attacks);
+#else
+    orth_attacks = kogge_stone_attacks_scalar(orth, 0, occ);
+    diag_attacks = kogge_stone_attacks_scalar(0, diag, occ);
+#endif
+}
+
+// Set-wise attacks of the non-sliding pieces, by shifting
+constexpr Bitboard knight_attacks_setwise(Bitboard knights)
+{
+    return
+        ((knights << 17) & not_a) | ((knights << 15) & not_h) |
+        ((knights << 10) & ~(file_a | file_b)) | ((knights << 6) & ~(file_g | file_h)) |
+        ((knights >> 6) & ~(file_a | file_b)) | ((knights >> 10) & ~(file_g | file_h)) |
+        ((knights >> 15) & not_a) | ((knights >> 17) & not_h);
+}
+
+constexpr Bitboard king_attacks_setwise(Bitboard kings)
+{
+    return
+        (kings << 8) | (kings >> 8) |
+        ((kings << 1) & not_a) | ((kings >> 1) & not_h) |
+        ((kings << 9) & not_a) | ((kings << 7) & not_h) |
+        ((kings >> 7) & not_a) | ((kings >> 9) & not_h);
+}
+
+constexpr Bitboard pawn_attacks_setwise(Bitboard pawns, bool white)
+{
+    if (white)
+        return ((pawns << 9) & not_a) | ((pawns << 7) & not_h);
+    else
+        return ((pawns >> 7) & not_a) | ((pawns >> 9) & not_h);
+}
+
+// Fills every square above (north) or below (south) the given squares
+constexpr Bitboard fill_north(Bitboard b)
+{
+    b |= b << 8;
+    b |= b << 16;
+    b |= b << 32;
+    return b;
+}
+
+constexpr Bitboard fill_south(Bitboard b)
+{
+    b |= b >> 8;
+    b |= b >> 16;
+    b |= b >> 32;
+    return b;
+}
+
+inline Bitboard bishop_attacks_setwise(Bitboard bishops, Bitboard occ)
+{
+    return kogge_stone_attacks(0, bishops, occ);
+}
+
+inline Bitboard rook_attacks_setwise(Bitboard rooks, Bitboard occ)
+{
+    return kogge_stone_attacks(rooks, 0, occ);
+}
+
+inline Bitboard queen_attacks_setwise(Bitboard queens, Bitboard occ)
+{
+    return kogge_stone_attacks(queens, queens, occ);
+}
+
+#endif
@@ -236,6 +236,8 @@ public:
 class MoveList
 {
 public:
+    static constexpr std::uint8_t capacity = 200;
+
     std::uint8_t size() const
     {
         return list_size;
@@ -273,7 +275,7 @@ public:
 
 private:
     std::uint8_t list_size = 0;
-    std::array<Move, 200> list;
+    std::array<Move, capacity> list;
 };
 
 //std::array<std::tuple<bool, MoveList, MoveList>, 200> g_movelists;
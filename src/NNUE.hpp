@@ -0,0 +1,345 @@
+#ifndef NNUE_HPP
+#define NNUE_HPP
+
+#include "evaluation.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Efficiently updatable neural network evaluation. The network is
+// 768 -> 2x128 -> 32 -> 1:
+//   Feature transformer: one input per (colour, piece, square) seen from each
+//   side, kept as an int16 accumulator per side and updated as pieces move.
+//   Hidden layer: clipped [0, 127] accumulators of the side to move and the
+//   other side as uint8, int8 weights, int32 sums.
+//   Output: clipped hidden layer, int8 weights, scaled to centipawns.
+//
+// Weight file, little endian, in this order:
+//   "NNUE" magic, then ft_biases (int16 x 128), ft_weights (int16 x 768 x 128),
+//   l1_biases (int32 x 32), l1_weights (int8 x 32 x 256), l2_bias (int32),
+//   l2_weights (int8 x 32)
+namespace nnue
+{
+    constexpr std::size_t inputs = 768;
+    constexpr std::size_t hidden = 128;
+    constexpr std::size_t l1_size = 32;
+
+    constexpr int l1_shift = 6;
+    constexpr int output_scale = 16;
+
+    using Accumulator = std::array<std::int16_t, hidden>;
+
+    // Feature index of a piece seen from perspective (0 white, 1 black). Black
+    // sees the board flipped with the colours swapped.
+    constexpr std::size_t feature(std::uint8_t perspective, std::uint8_t color, std::uint8_t piece, std::uint8_t sq)
+    {
+        if (perspective == 1)
+        {
+            color ^= 1;
+            sq ^= 56;
+        }
+
+        return (color*6 + piece)*64 + sq;
+    }
+
+    struct Network
+    {
+        alignas(32) Accumulator ft_biases;
+        alignas(32) std::array<Accumulator, inputs> ft_weights;
+        alignas(32) std::array<std::int32_t, l1_size> l1_biases;
+        alignas(32) std::array<std::array<std::int8_t, 2*hidden>, l1_size> l1_weights;
+        std::int32_t l2_bias;
+        alignas(32) std::array<std::int8_t, l1_size> l2_weights;
+
+        bool loaded = false;
+
+        // Reads into a copy first, a missing or truncated file leaves the
+        // current weights as they were
+        bool load(const std::string &path)
+        {
+            std::ifstream f(path, std::ios::binary);
+
+            char magic[4];
+            f.read(magic, 4);
+
+            if (!f || std::string(magic, 4) != "NNUE")
+                return false;
+
+            std::unique_ptr<Network> n = std::make_unique<Network>();
+
+            f.read(reinterpret_cast<char*>(n->ft_biases.data()), sizeof(n->ft_biases));
+            f.read(reinterpret_cast<char*>(n->ft_weights.data()), sizeof(n->ft_weights));
+            f.read(reinterpret_cast<char*>(n->l1_biases.data()), sizeof(n->l1_biases));
+            f.read(reinterpret_cast<char*>(n->l1_weights.data()), sizeof(n->l1_weights));
+            f.read(reinterpret_cast<char*>(&n->l2_bias), sizeof(n->l2_bias));
+            f.read(reinterpret_cast<char*>(n->l2_weights.data()), sizeof(n->l2_weights));
+
+            if (!f)
+                return false;
+
+            n->loaded = true;
+            *this = *n;
+
+            return true;
+        }
+
+        bool save(const std::string &path) const
+        {
+            std::ofstream f(path, std::ios::binary);
+
+            f.write("NNUE", 4);
+            f.write(reinterpret_cast<const char*>(ft_biases.data()), sizeof(ft_biases));
+            f.write(reinterpret_cast<const char*>(ft_weights.data()), sizeof(ft_weights));
+            f.write(reinterpret_cast<const char*>(l1_biases.data()), sizeof(l1_biases));
+            f.write(reinterpret_cast<const char*>(l1_weights.data()), sizeof(l1_weights));
+            f.write(reinterpret_cast<const char*>(&l2_bias), sizeof(l2_bias));
+            f.write(reinterpret_cast<const char*>(l2_weights.data()), sizeof(l2_weights));
+
+            return static_cast<bool>(f);
+        }
+
+        // Small random weights, for benchmarking and testing without a file
+        void randomize(std::uint32_t seed)
+        {
+            std::mt19937 rng(seed);
+            std::uniform_int_distribution<int> small(-8, 8);
+            std::uniform_int_distribution<int> tiny(-2, 2);
+
+            for (std::int16_t &b : ft_biases)
+                b = small(rng);
+            for (Accumulator &w : ft_weights)
+                for (std::int16_t &x : w)
+                    x = small(rng);
+            for (std::int32_t &b : l1_biases)
+                b = small(rng)*64;
+            for (auto &w : l1_weights)
+                for (std::int8_t &x : w)
+                    x = tiny(rng);
+            l2_bias = 0;
+            for (std::int8_t &x : l2_weights)
+                x = small(rng);
+
+            loaded = true;
+        }
+    };
+
+    // The network in use, loaded through the engine options
+    inline Network network;
+
+    // Set while the network is used for evaluation. Boards only keep
+    // accumulators while a loaded network is enabled, otherwise every move
+    // would pay for updates nobody reads.
+    inline bool enabled = false;
+
+    inline bool active()
+    {
+        return enabled && network.loaded;
+    }
+
+    // Accumulators from white's (0) and black's (1) point of view. They are
+    // only allocated while a network is active, so boards stay small and
+    // cheap to copy otherwise.
+    class AccumulatorPair
+    {
+    public:
+        AccumulatorPair() = default;
+
+        AccumulatorPair(const AccumulatorPair &o) :
+            data(o.data ? std::make_unique<Data>(*o.data) : nullptr)
+        {
+        }
+
+        // Reuses the allocation, boards on a search stack are assigned to
+        // at every node
+        AccumulatorPair& operator=(const AccumulatorPair &o)
+        {
+            if (!o.data)
+                data.reset();
+            else if (data)
+                *data = *o.data;
+            else
+                data = std::make_unique<Data>(*o.data);
+
+            return *this;
+        }
+
+        bool operator==(const AccumulatorPair &o) const
+        {
+            if (!data || !o.data)
+                return !data && !o.data;
+
+            return data->acc == o.data->acc;
+        }
+
+        // Starts from the biases, as for an empty board
+        void reset()
+        {
+            if (!data)
+                data = std::make_unique<Data>();
+
+            data->acc = {network.ft_biases, network.ft_biases};
+        }
+
+        bool active() const
+        {
+            return data != nullptr;
+        }
+
+        Accumulator& operator[](std::size_t perspective)
+        {
+            return data->acc[perspective];
+        }
+
+        const Accumulator& operator[](std::size_t perspective) const
+        {
+            return data->acc[perspective];
+        }
+
+    private:
+        struct Data
+        {
+            alignas(32) std::array<Accumulator, 2> acc;
+        };
+
+        std::unique_ptr<Data> data;
+    };
+
+    // Adds (sign 1) or removes (sign -1) a feature column from an accumulator
+    inline void update_scalar(Accumulator &acc, std::size_t f, int sign)
+    {
+        const Accumulator &w = network.ft_weights[f];
+
+        for (std::size_t i = 0; i < hidden; i++)
+            acc[i] += sign*w[i];
+    }
+
+#ifdef __AVX2__
+    inline void update_avx2(Accumulator &acc, std::size_t f, int sign)
+    {
+        const Accumulator &w = network.ft_weights[f];
+
+        for (std::size_t i = 0; i < hidden; i += 16)
+        {
+            const __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(&acc[i]));
+            const __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i*>(&w[i]));
+            const __m256i r = (sign > 0) ? _mm256_add_epi16(a, b) : _mm256_sub_epi16(a, b);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(&acc[i]), r);
+        }
+    }
+#endif
+
+    inline void update(Accumulator &acc, std::size_t f, int sign)
+    {
+#ifdef __AVX2__
+        update_avx2(acc, f, sign);
+#else
+        update_scalar(acc, f, sign);
+#endif
+    }
+
+    // Score in centipawns for the side to move, given the accumulators of
+    // the side to move and of the other side
+    inline Score evaluate_scalar(const Accumulator &us, const Accumulator &them)
+    {
+        std::array<std::uint8_t, 2*hidden> input;
+
+        for (std::size_t i = 0; i < hidden; i++)
+        {
+            input[i] = std::clamp<int>(us[i], 0, 127);
+            input[hidden+i] = std::clamp<int>(them[i], 0, 127);
+        }
+
+        std::int32_t out = network.l2_bias;
+
+        for (std::size_t j = 0; j < l1_size; j++)
+        {
+            std::int32_t sum = network.l1_biases[j];
+
+            for (std::size_t i = 0; i < 2*hidden; i++)
+                sum += input[i]*network.l1_weights[j][i];
+
+            out += std::clamp(sum >> l1_shift, 0, 127)*network.l2_weights[j];
+        }
+
+        return out/output_scale;
+    }
+
+#ifdef __AVX2__
+    inline Score evaluate_avx2(const Accumulator &us, const Accumulator &them)
+    {
+        // Clip to [0, 127] and pack to uint8. packus interleaves the 128 bit
+        // lanes, the permute puts the bytes back in order.
+        alignas(32) std::array<std::uint8_t, 2*hidden> input;
+
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i max = _mm256_set1_epi16(127);
+
+        for (std::size_t half = 0; half < 2; half++)
+        {
+            const Accumulator &acc = (half == 0) ? us : them;
+
+            for (std::size_t i = 0; i < hidden; i += 32)
+            {
+                __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(&acc[i]));
+                __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i*>(&acc[i+16]));
+                a = _mm256_min_epi16(_mm256_max_epi16(a, zero), max);
+                b = _mm256_min_epi16(_mm256_max_epi16(b, zero), max);
+
+                const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+                _mm256_store_si256(reinterpret_cast<__m256i*>(&input[half*hidden + i]), packed);
+            }
+        }
+
+        // uint8 x int8 pairs never saturate the int16 sums of maddubs, since
+        // 2*127*128 < 32768
+        const __m256i ones = _mm256_set1_epi16(1);
+
+        std::int32_t out = network.l2_bias;
+
+        for (std::size_t j = 0; j < l1_size; j++)
+        {
+            __m256i sum = _mm256_setzero_si256();
+
+            for (std::size_t i = 0; i < 2*hidden; i += 32)
+            {
+                const __m256i x = _mm256_load_si256(reinterpret_cast<const __m256i*>(&input[i]));
+                const __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i*>(&network.l1_weights[j][i]));
+                sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(x, w), ones));
+            }
+
+            __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+            s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+            s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+
+            const std::int32_t h = network.l1_biases[j] + _mm_cvtsi128_si32(s);
+            out += std::clamp(h >> l1_shift, 0, 127)*network.l2_weights[j];
+        }
+
+        return out/output_scale;
+    }
+#endif
+
+    // Kept short of the mate scores, which also keeps it inside the int16
+    // entries of the eval cache
+    inline Score evaluate(const Accumulator &us, const Accumulator &them)
+    {
+#ifdef __AVX2__
+        const Score score = evaluate_avx2(us, them);
+#else
+        const Score score = evaluate_scalar(us, them);
+#endif
+
+        return std::clamp(score, -mate_bound + 1, mate_bound - 1);
+    }
+}
+
+#endif
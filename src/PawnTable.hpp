@@ -0,0 +1,80 @@
+#ifndef PAWN_TABLE_HPP
+#define PAWN_TABLE_HPP
+
+#include "Bitboard.hpp"
+#include "evaluation.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Pawn structure evaluation, depends only on the pawns of both sides
+struct PawnEntry
+{
+    std::uint64_t key = 0;
+    Score score = 0; // From white's point of view
+    std::array<Bitboard, 2> passed = {0}; // Passed pawns, white and black
+};
+
+// Direct mapped cache of pawn structure evaluations keyed by the pawn hash.
+// Pawn structure rarely changes between neighbouring nodes, so it hits often.
+// Not shared between threads.
+class PawnTable
+{
+public:
+    PawnTable(std::size_t entries_ = 16384) :
+        entries(entries_)
+    {
+    }
+
+    bool probe(std::uint64_t key, PawnEntry &entry)
+    {
+        probes++;
+
+        const PawnEntry &e = entries[key & (entries.size()-1)];
+
+        if (e.key != key)
+            return false;
+
+        hits++;
+        entry = e;
+
+        return true;
+    }
+
+    void store(const PawnEntry &entry)
+    {
+        entries[entry.key & (entries.size()-1)] = entry;
+    }
+
+    void clear()
+    {
+        std::fill(entries.begin(), entries.end(), PawnEntry{});
+        reset_stats();
+    }
+
+    void reset_stats()
+    {
+        probes = 0;
+        hits = 0;
+    }
+
+    std::uint64_t get_probes() const
+    {
+        return probes;
+    }
+
+    std::uint64_t get_hits() const
+    {
+        return hits;
+    }
+
+private:
+    std::vector<PawnEntry> entries; // Size is a power of two
+
+    std::uint64_t probes = 0;
+    std::uint64_t hits = 0;
+};
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef TRANSPOSITION_TABLE_HPP
+#define TRANSPOSITION_TABLE_HPP
+
+#include "Move.hpp"
+#include "evaluation.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// What a stored score says about the true score
+enum class Bound : std::uint8_t
+{
+    None = 0,
+    Exact,
+    Lower, // True score is at least this
+    Upper  // True score is at most this
+};
+
+struct TTData
+{
+    Move move;
+    Score score;
+    int depth;
+    Bound bound;
+};
+
+// Search results keyed by zobrist hash. Entries are 16 bytes, the key and a
+// packed word of move, score, depth, bound and generation, four to a 64 byte
+// bucket so that a probe touches a single cache line.
+//
+// Shared by all search threads without locks. The key is stored XORed with
+// the data word, so an entry torn by two threads writing it at once fails the
+// key check instead of returning another position's data.
+//
+// Mate scores are stored as distance from the node rather than from the
+// root, so they stay right when the position is reached at another ply.
+class TranspositionTable
+{
+public:
+    TranspositionTable(std::size_t mb = 16)
+    {
+        resize(mb);
+    }
+
+    // Size in megabytes, rounded down to a power of two buckets
+    void resize(std::size_t mb)
+    {
+        std::size_t n = 1;
+        while (n*2*sizeof(Bucket) <= mb*1024*1024)
+            n *= 2;
+
+        buckets.reset(new Bucket[n]);
+        mask = n-1;
+        size = n;
+
+        clear();
+    }
+
+    void clear()
+    {
+        for (std::size_t i = 0; i < size; i++)
+        {
+            for (Entry &e : buckets[i].entries)
+            {
+                e.key.store(0, std::memory_order_relaxed);
+                e.data.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        generation = 0;
+    }
+
+    // Called at the start of every search, older entries get replaced first
+    void new_search()
+    {
+        generation = (generation + 1) & generation_mask;
+    }
+
+    bool probe(std::uint64_t key, int ply, TTData &data)
+    {
+        const Bucket &b = buckets[key & mask];
+
+        for (const Entry &e : b.entries)
+        {
+            const std::uint64_t d = e.data.load(std::memory_order_relaxed);
+
+            if ((e.key.load(std::memory_order_relaxed) ^ d) != key || unpack_bound(d) == Bound::None)
+                continue;
+
+            data.move.data = d & 0xFFFF;
+            data.score = from_tt(static_cast<std::int16_t>((d >> 16) & 0xFFFF), ply);
+            data.depth = (d >> 32) & 0xFF;
+            data.bound = unpack_bound(d);
+
+            return true;
+        }
+
+        return false;
+    }
+
+    void store(std::uint64_t key, int ply, Move move, Score score, int depth, Bound bound)
+    {
+        Bucket &b = buckets[key & mask];
+
+        // The same position, else the shallowest and oldest entry
+        Entry *replace = &b.entries[0];
+        int replace_worth = worth(replace->data.load(std::memory_order_relaxed));
+
+        for (Entry &e : b.entries)
+        {
+            const std::uint64_t d = e.data.load(std::memory_order_relaxed);
+
+            if ((e.key.load(std::memory_order_relaxed) ^ d) == key)
+            {
+                replace = &e;
+
+                // Keep the old move rather than none
+                if (move.data == 0)
+                    move.data = d & 0xFFFF;
+
+                break;
+            }
+
+            if (worth(d) < replace_worth)
+            {
+                replace = &e;
+                replace_worth = worth(d);
+            }
+        }
+
+        const std::uint64_t data =
+            std::uint64_t{move.data} |
+            (std::uint64_t{static_cast<std::uint16_t>(to_tt(score, ply))} << 16) |
+            (std::uint64_t{static_cast<std::uint8_t>(depth)} << 32) |
+            (std::uint64_t{static_cast<std::uint8_t>(bound)} << 40) |
+            (std::uint64_t{generation} << 42);
+
+        replace->key.store(key ^ data, std::memory_order_relaxed);
+        replace->data.store(data, std::memory_order_relaxed);
+    }
+
+    // Permille of the sampled entries written in the current search
+    int hashfull() const
+    {
+        int used = 0;
+        const std::size_t sample = std::min(size, std::size_t{250});
+
+        for (std::size_t i = 0; i < sample; i++)
+        {
+            for (const Entry &e : buckets[i].entries)
+            {
+                const std::uint64_t d = e.data.load(std::memory_order_relaxed);
+
+                if (unpack_bound(d) != Bound::None && unpack_generation(d) == generation)
+                    used++;
+            }
+        }
+
+        return (used*1000)/(sample*bucket_size);
+    }
+
+private:
+    static constexpr std::size_t bucket_size = 4;
+    static constexpr std::uint8_t generation_mask = 0x3F;
+
+    struct Entry
+    {
+        std::atomic<std::uint64_t> key = 0; // Zobrist key ^ data
+        std::atomic<std::uint64_t> data = 0; // Move (0:15), score (16:31), depth (32:39), bound (40:41), generation (42:47)
+    };
+
+    struct alignas(64) Bucket
+    {
+        std::array<Entry, bucket_size> entries;
+    };
+
+    static Bound unpack_bound(std::uint64_t data)
+    {
+        return static_cast<Bound>((data >> 40) & 0x3);
+    }
+
+    static std::uint8_t unpack_generation(std::uint64_t data)
+    {
+        return (data >> 42) & generation_mask;
+    }
+
+    // Replacement value, each search of age counts as 8 plies of depth
+    int worth(std::uint64_t data) const
+    {
+        if (unpack_bound(data) == Bound::None)
+            return -1000;
+
+        const int age = (generation - unpack_generation(data)) & generation_mask;
+        return static_cast<int>((data >> 32) & 0xFF) - 8*age;
+    }
+
+    static Score to_tt(Score s, int ply)
+    {
+        if (s >= mate_bound)
+            return s + ply;
+        if (s <= -mate_bound)
+            return s - ply;
+        return s;
+    }
+
+    static Score from_tt(Score s, int ply)
+    {
+        if (s >= mate_bound)
+            return s - ply;
+        if (s <= -mate_bound)
+            return s + ply;
+        return s;
+    }
+
+    std::unique_ptr<Bucket[]> buckets;
+    std::size_t mask = 0;
+    std::size_t size = 0;
+
+    std::uint8_t generation = 0; // Only changed between searches
+};
+
+#endif
@@ -3,11 +3,15 @@
 
 #include "Board.hpp"
 #include "BoardTree.hpp"
+#include "EvalCache.hpp"
+#include "TranspositionTable.hpp"
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <iterator>
 #include <mutex>
@@ -17,12 +21,142 @@
 #include <thread>
 #include <vector>
 
+namespace search_tables
+{
+    // Natural logarithm for the tables below, ln(x) = k ln(2) + ln(x/2^k)
+    // with the last term from its atanh series
+    constexpr double ln(double x)
+    {
+        int k = 0;
+        while (x >= 2)
+        {
+            x /= 2;
+            k++;
+        }
+
+        const double y = (x - 1)/(x + 1);
+        double term = y;
+        double sum = 0;
+
+        for (int n = 1; n < 40; n += 2)
+        {
+            sum += term/n;
+            term *= y*y;
+        }
+
+        return k*0.6931471805599453 + 2*sum;
+    }
+
+    // Late move reduction in plies by depth left and move number (from 1)
+    constexpr int lmr_size = 64;
+
+    constexpr std::array<std::array<std::uint8_t, lmr_size>, lmr_size> make_reductions()
+    {
+        std::array<std::array<std::uint8_t, lmr_size>, lmr_size> t = {};
+
+        for (int d = 1; d < lmr_size; d++)
+            for (int m = 1; m < lmr_size; m++)
+                t[d][m] = static_cast<std::uint8_t>(0.75 + ln(d)*ln(m)/2.25);
+
+        return t;
+    }
+
+    constexpr std::array<std::array<std::uint8_t, lmr_size>, lmr_size> reductions = make_reductions();
+}
+
+// One ply of a search stack
+struct SearchPly
+{
+    Board board;
+    MoveList moves;
+
+    // Best line found from this ply, the row of the triangular PV table
+    std::array<Move, max_ply> pv;
+    int pv_length = 0;
+
+    // Ordering score of each move in moves
+    std::array<std::int32_t, MoveList::capacity> move_scores;
+
+    // Quiet moves that caused a beta cutoff at this ply, newest first
+    std::array<Move, 2> killers;
+};
+
+// Everything one search thread changes while searching. Thread 0 is the main
+// thread, whose result is reported, the helpers of Lazy SMP only share what
+// they find through the transposition table.
+struct SearchThread
+{
+    SearchThread() :
+        stack(max_ply + 1)
+    {
+    }
+
+    int id = 0;
+
+    Board board;
+    std::vector<std::uint64_t> z_list;
+
+    // Position and moves at each ply, allocated once so that searching
+    // does not allocate
+    std::vector<SearchPly> stack;
+
+    PawnTable pawn_table;
+
+    // Nodes visited by this thread in the current search
+    std::uint64_t nodes = 0;
+
+    // Probes of the shared transposition table and evaluation cache, and
+    // their hits. Counted per thread, shared counters would be written by
+    // every thread at every node.
+    std::uint64_t tt_probes = 0;
+    std::uint64_t tt_hits = 0;
+    std::uint64_t eval_probes = 0;
+    std::uint64_t eval_hits = 0;
+
+    // Lazy evaluations, and those that stopped at the material score
+    std::uint64_t lazy_evals = 0;
+    std::uint64_t lazy_cutoffs = 0;
+
+    // Butterfly history of quiet moves causing cutoffs, by colour, from and to
+    std::array<std::array<std::array<std::int32_t, 64>, 64>, 2> history = {};
+
+    // Set while verifying a null move cutoff, no null moves below
+    bool no_null = false;
+
+    // Null moves tried, and those that cut the node off
+    std::uint64_t null_moves = 0;
+    std::uint64_t null_cutoffs = 0;
+
+    // Late moves searched reduced, and those searched again at full depth
+    std::uint64_t reduced_moves = 0;
+    std::uint64_t reduced_researches = 0;
+
+    // Beta cutoffs, and those by the first move searched
+    std::uint64_t cutoffs = 0;
+    std::uint64_t first_move_cutoffs = 0;
+
+    // Aspiration window searches, and those that had to be searched again
+    std::uint64_t aspiration_searches = 0;
+    std::uint64_t aspiration_fail_highs = 0;
+    std::uint64_t aspiration_fail_lows = 0;
+
+    // Best move of the last root search
+    Move root_move;
+
+    // Principal variation of the last iteration, searched first by the next
+    // one while follow_pv is set
+    std::array<Move, max_ply> pv_line;
+    int pv_line_length = 0;
+    bool follow_pv = false;
+};
+
 class UCIEngine
 {
 public:
     UCIEngine()
     {
         thinking = false;
+        threads.resize(1);
         eng = std::mt19937(r());
         log.open("/tmp/UCI_Engine.log");
     }
@@ -43,20 +177,379 @@ protected:
     std::atomic<std::uint64_t> b_inc = 0;
     std::atomic<bool> infinite = false;
 
+    // Search limits, 0 if not limited. Depth stays below max_ply.
+    int depth_limit = 0;
+
+    // Nodes visited by the current search, all threads
+    std::uint64_t nodes = 0;
+
     Move bestmove;
-    std::atomic<double> evaluation = 0;
+    std::atomic<Score> evaluation = 0; // Centipawns for the side to move
+    std::vector<Move> principal_variation; // Reported with the score when not empty
     std::atomic<bool> thinking = false;
 
     std::vector<std::uint64_t> z_list;
 
+    // Search results, sized by the Hash option
+    TranspositionTable tt;
+
+    // Static evaluations shared across iterations, transpositions and threads
+    EvalCache eval_cache;
+
+    // Sized by the Threads option, threads[0] is the main thread
+    std::vector<SearchThread> threads;
+
+    // Set when the main thread is done, helpers abandon their search
+    std::atomic<bool> stop_search = false;
+
+    // Half width of the first aspiration window around the last iteration's
+    // score, doubled on every fail high or fail low
+    static constexpr Score aspiration_window = 50;
+
     std::mt19937 eng;
 
     std::ofstream log;
 
+    // Static evaluation with the selected evaluator
+    Score evaluate(SearchThread &t, const Board &b, const MoveList &movelist, int ply)
+    {
+        if (nnue::active())
+            return b.nnue_eval(movelist, ply);
+
+        return b.adv_eval(movelist, ply, &t.pawn_table);
+    }
+
+    bool probe_eval_cache(SearchThread &t, std::uint64_t key, Score &score)
+    {
+        if (!eval_cache.enabled())
+            return false;
+
+        t.eval_probes++;
+
+        if (!eval_cache.probe(key, score))
+            return false;
+
+        t.eval_hits++;
+        return true;
+    }
+
+    // evaluate through the evaluation cache. Terminal nodes are not cached,
+    // their score depends on the ply and on the repetition history.
+    Score cached_eval(SearchThread &t, const Board &b, const MoveList &movelist, int ply)
+    {
+        if (movelist.is_checkmate || movelist.is_stalemate)
+            return evaluate(t, b, movelist, ply);
+
+        const std::uint64_t key = b.get_zobrist();
+
+        Score score;
+        if (probe_eval_cache(t, key, score))
+            return score;
+
+        score = evaluate(t, b, movelist, ply);
+        eval_cache.store(key, score);
+
+        return score;
+    }
+
+    // cached_eval against a search window (white's point of view). Outside
+    // the window a cheap bound may be returned instead of the full score,
+    // only full scores go into the cache.
+    Score lazy_eval(SearchThread &t, const Board &b, const MoveList &movelist, int ply, Score alpha, Score beta)
+    {
+        if (nnue::active())
+            return cached_eval(t, b, movelist, ply);
+
+        if (movelist.is_checkmate || movelist.is_stalemate)
+            return evaluate(t, b, movelist, ply);
+
+        const std::uint64_t key = b.get_zobrist();
+
+        Score score;
+        if (probe_eval_cache(t, key, score))
+            return score;
+
+        bool exact;
+        score = b.adv_eval_lazy(movelist, ply, alpha, beta, &t.pawn_table, exact);
+
+        t.lazy_evals++;
+
+        if (exact)
+            eval_cache.store(key, score);
+        else
+            t.lazy_cutoffs++;
+
+        return score;
+    }
+
+    // Looks the node up in the transposition table. True when the stored
+    // result is deep enough to settle the node against the fail hard window,
+    // with the score in score. Window and scores are from whichever point of
+    // view the engine stores. tt_move is set to the stored best move for
+    // ordering, or to no move.
+    bool tt_cutoff(SearchThread &t, std::uint64_t key, int depthleft, int ply, Score alpha, Score beta, Score &score, Move &tt_move)
+    {
+        tt_move = Move();
+
+        t.tt_probes++;
+
+        TTData data;
+        if (!tt.probe(key, ply, data))
+            return false;
+
+        t.tt_hits++;
+        tt_move = data.move;
+
+        if (data.depth < depthleft)
+            return false;
+
+        if (data.bound == Bound::Exact)
+        {
+            score = std::clamp(data.score, alpha, beta);
+            return true;
+        }
+
+        if (data.bound == Bound::Lower && data.score >= beta)
+        {
+            score = beta;
+            return true;
+        }
+
+        if (data.bound == Bound::Upper && data.score <= alpha)
+        {
+            score = alpha;
+            return true;
+        }
+
+        return false;
+    }
+
+    // Ordering score of a move to search first (table or PV move)
+    static constexpr std::int32_t order_first = 1 << 30;
+    static constexpr std::int32_t order_capture = 1 << 29;
+    static constexpr std::int32_t order_killer = 1 << 28;
+
+    // Captures that lose material by SEE go after the quiet moves
+    static constexpr std::int32_t order_losing = -(1 << 28);
+
+    // History scores are halved before reaching this, below the killers
+    static constexpr std::int32_t history_max = 1 << 20;
+
+    // Captures, en passant and promotions, ordered by MVV-LVA
+    static bool is_tactical(const Board &pos, Move m)
+    {
+        return pos.get_color(m.get_to()) != Color::Empty ||
+            m.get_type() == MoveSpecial::EnPassant ||
+            m.get_type() == MoveSpecial::Promotion;
+    }
+
+    // Most valuable victim first, least valuable attacker among equals.
+    // Promotions count the new piece as a victim.
+    static std::int32_t mvv_lva(const Board &pos, Move m)
+    {
+        const Piece victim = (m.get_type() == MoveSpecial::EnPassant) ? Piece::Pawn : pos.get_piece(m.get_to());
+        const Piece attacker = pos.get_piece(m.get_from());
+
+        std::int32_t score = (victim == Piece::None) ? 0 : 8*(static_cast<std::int32_t>(victim) + 1);
+
+        if (m.get_type() == MoveSpecial::Promotion)
+            score += 8*static_cast<std::int32_t>(m.get_promo());
+
+        return score - static_cast<std::int32_t>(attacker);
+    }
+
+    // Scores the moves at ply for ordering: first, then captures by MVV-LVA,
+    // then killers, then quiet moves by history, then losing captures
+    static void score_moves(SearchThread &t, const Board &pos, MoveList &moves, int ply, Move first)
+    {
+        SearchPly &node = t.stack[ply];
+        const auto &history = t.history[static_cast<std::uint8_t>(pos.get_turn())];
+
+        std::uint8_t i = 0;
+        for (const Move &m : moves)
+        {
+            std::int32_t &score = node.move_scores[i++];
+
+            if (m.data == first.data)
+                score = order_first;
+            else if (is_tactical(pos, m))
+                score = (pos.see_ge(m, 0) ? order_capture : order_losing) + mvv_lva(pos, m);
+            else if (m.data == node.killers[0].data)
+                score = order_killer + 1;
+            else if (m.data == node.killers[1].data)
+                score = order_killer;
+            else
+                score = history[m.get_from()][m.get_to()];
+        }
+    }
+
+    // Swaps the best scored of the moves from i on into i, so that moves are
+    // only sorted as far as they are searched
+    static void pick_move(SearchThread &t, MoveList &moves, int ply, std::uint8_t i)
+    {
+        std::array<std::int32_t, MoveList::capacity> &scores = t.stack[ply].move_scores;
+        Move *list = moves.begin();
+
+        std::uint8_t best = i;
+        for (std::uint8_t j = i+1; j < moves.size(); j++)
+            if (scores[j] > scores[best])
+                best = j;
+
+        std::swap(list[i], list[best]);
+        std::swap(scores[i], scores[best]);
+    }
+
+    // Beta cutoff by the i'th move searched. Quiet moves become killers and
+    // gain history.
+    static void record_cutoff(SearchThread &t, const Board &pos, int ply, int depthleft, Move m, std::uint8_t i)
+    {
+        t.cutoffs++;
+        if (i == 0)
+            t.first_move_cutoffs++;
+
+        if (is_tactical(pos, m))
+            return;
+
+        std::array<Move, 2> &killers = t.stack[ply].killers;
+        if (killers[0].data != m.data)
+        {
+            killers[1] = killers[0];
+            killers[0] = m;
+        }
+
+        auto &history = t.history[static_cast<std::uint8_t>(pos.get_turn())];
+        std::int32_t &h = history[m.get_from()][m.get_to()];
+
+        h += depthleft*depthleft;
+
+        if (h >= history_max)
+            for (auto &from : history)
+                for (std::int32_t &to : from)
+                    to /= 2;
+    }
+
+    // Whether the side to move may try a null move: not in check, not right
+    // after another, and with pieces, as pawn endings are full of zugzwang
+    static bool null_move_allowed(const SearchThread &t, const Board &pos, int depthleft)
+    {
+        return
+            !t.no_null &&
+            depthleft >= 3 &&
+            pos.movetohere.data != 0 &&
+            pos.get_checkers() == 0 &&
+            endgame::non_pawn_material(pos.get_material_key(), static_cast<std::uint8_t>(pos.get_turn())) > 0;
+    }
+
+    static int null_move_reduction(int depthleft)
+    {
+        return (depthleft >= 6) ? 3 : 2;
+    }
+
+    // Moves searched before late move reductions start
+    static constexpr std::uint8_t lmr_moves = 3;
+
+    // Late move reduction of the i'th move searched (from 0) with depthleft,
+    // 0 if it is not reduced. Only quiet moves that are neither first nor a
+    // killer, don't give check and are not made in check are reduced, and
+    // always to at least depth 1. Captures scored below zero lose material
+    // by SEE, they are not reduced either.
+    static int late_move_reduction(const SearchThread &t, const Board &pos, const Board &child, int ply, int depthleft, std::uint8_t i)
+    {
+        if (
+                depthleft < 3 ||
+                i < lmr_moves ||
+                t.stack[ply].move_scores[i] >= order_killer ||
+                t.stack[ply].move_scores[i] < 0 ||
+                pos.get_checkers() != 0 ||
+                child.get_checkers() != 0
+           )
+        {
+            return 0;
+        }
+
+        const int reduction = search_tables::reductions
+            [std::min(depthleft, search_tables::lmr_size-1)]
+            [std::min(i+1, search_tables::lmr_size-1)];
+
+        return std::min(reduction, depthleft - 2);
+    }
+
+    // Futility of losing captures: with this little depth left, a capture
+    // losing more by SEE than see_margin per ply is not expected to win it
+    // back and is not searched. Only losing captures score below zero.
+    static constexpr int see_prune_depth = 3;
+    static constexpr Score see_margin = 100;
+
+    static bool see_prune(const SearchThread &t, const Board &pos, const Board &child, int ply, int depthleft, Move m, std::uint8_t i)
+    {
+        return
+            depthleft <= see_prune_depth &&
+            i != 0 &&
+            t.stack[ply].move_scores[i] < 0 &&
+            pos.get_checkers() == 0 &&
+            child.get_checkers() == 0 &&
+            !pos.see_ge(m, -see_margin*depthleft);
+    }
+
+    // Null move cutoffs are verified by a reduced search of the node itself
+    // when the side to move has no more than two rooks' worth of pieces
+    static bool null_move_verify(const Board &pos)
+    {
+        return endgame::non_pawn_material(pos.get_material_key(), static_cast<std::uint8_t>(pos.get_turn())) <=
+            2*eval_tables::piece_values[3];
+    }
+
+    // True once a helper should stop, its result is then thrown away and
+    // must not be stored
+    bool stopped() const
+    {
+        return stop_search.load(std::memory_order_relaxed);
+    }
+
+    // Lazy SMP. search is the engine's iterative deepening and is run by
+    // every thread on its own copy of the position, the main thread on this
+    // one. Helpers are stopped when the main thread returns.
+    void search_threads(const std::function<void(SearchThread&)> &search)
+    {
+        stop_search = false;
+
+        for (std::size_t i = 0; i < threads.size(); i++)
+        {
+            SearchThread &t = threads[i];
+            t.id = i;
+            t.board = board;
+            t.z_list = z_list;
+            t.z_list.reserve(z_list.size() + max_ply);
+            t.stack[0].board = board;
+            t.nodes = 0;
+            t.root_move = Move();
+            t.pv_line_length = 0;
+            t.no_null = false;
+
+            for (SearchPly &node : t.stack)
+                node.killers = {};
+        }
+
+        std::vector<std::thread> helpers;
+        for (std::size_t i = 1; i < threads.size(); i++)
+            helpers.emplace_back(search, std::ref(threads[i]));
+
+        search(threads[0]);
+
+        stop_search = true;
+        for (std::thread &h : helpers)
+            h.join();
+
+        nodes = 0;
+        for (const SearchThread &t : threads)
+            nodes += t.nodes;
+    }
+
     void start()
     {
         rx_thread = std::thread(&UCIEngine::rx_loop, this);
         state_loop();
+        rx_thread.detach();
     }
 
 private:
@@ -65,7 +558,14 @@ private:
         while (1)
         {
             std::string cmd;
-            std::getline(std::cin, cmd);
+            if (!std::getline(std::cin, cmd))
+            {
+                // Input closed, treat as quit
+                rx_buffer_mutex.lock();
+                rx_buffer.push_back({"quit"});
+                rx_buffer_mutex.unlock();
+                return;
+            }
 
             if (cmd == "")
                 continue;
@@ -110,6 +610,9 @@ private:
                     send_cmd("option name Threads type spin default 1 min 1 max 512");
                     send_cmd("option name Hash type spin default 16 min 1 max 131072");
                     send_cmd("option name Clear Hash type button");
+                    send_cmd("option name Eval Cache type spin default 16 min 0 max 4096");
+                    send_cmd("option name EvalFile type string default <empty>");
+                    send_cmd("option name Use NNUE type check default false");
                     send_cmd("option name Ponder type check default false");
                     send_cmd("option name MultiPV type spin default 1 min 1 max 500");
                     send_cmd("option name Skill Level type spin default 20 min 0 max 20");
@@ -127,6 +630,26 @@ private:
                     send_cmd("uciok");
                 }
 
+                else if (tokens.at(0) == "setoption")
+                {
+                    // setoption name <id> [value <x>], both may contain spaces
+                    std::string name;
+                    std::string value;
+                    std::string *field = nullptr;
+
+                    for (std::size_t i = 1; i < tokens.size(); i++)
+                    {
+                        if (tokens.at(i) == "name")
+                            field = &name;
+                        else if (tokens.at(i) == "value")
+                            field = &value;
+                        else if (field != nullptr)
+                            *field += (field->empty() ? "" : " ") + tokens.at(i);
+                    }
+
+                    set_option(name, value);
+                }
+
                 else if (tokens.at(0) == "isready")
                 {
                     send_cmd("readyok");
@@ -200,6 +723,7 @@ private:
                 {
                     start_thinking_ts = std::chrono::steady_clock::now();
                     time_spent = 0;
+                    nodes = 0;
 
                     if (tokens.size() > 1 && tokens.at(1) == "perft")
                     {
@@ -227,6 +751,11 @@ private:
                     }
                     else
                     {
+                        depth_limit = 0;
+                        principal_variation.clear();
+                        tt.new_search();
+                        reset_thread_stats();
+
                         std::uint8_t i = 0;
                         while (++i < tokens.size())
                         {
@@ -245,6 +774,9 @@ private:
                             if (tokens.at(i) == "movetime")
                                 w_time = b_time = w_inc = b_inc = std::stoi(tokens.at(++i));
 
+                            if (tokens.at(i) == "depth")
+                                depth_limit = std::clamp(std::stoi(tokens.at(++i)), 0, max_ply - 1);
+
                             if (tokens.at(i) == "infinite")
                             {
                                 i++;
@@ -259,6 +791,14 @@ private:
                         think_thread = std::thread(&UCIEngine::think, this);
                     }
                 }
+                else if (tokens.at(0) == "bench")
+                {
+                    int d = 4;
+                    if (tokens.size() > 1)
+                        d = std::clamp(std::stoi(tokens.at(1)), 1, max_ply - 1);
+
+                    bench(d);
+                }
                 else if (tokens.at(0) == "puzzle")
                 {
                     if (tokens.at(1) == "1")
@@ -291,6 +831,7 @@ private:
 
                     start_thinking_ts = std::chrono::steady_clock::now();
                     time_spent = 0;
+                    nodes = 0;
                     w_time = 1000000;
                     b_time = 1000000;
                     w_inc = 10000;
@@ -309,13 +850,204 @@ private:
                     think_thread.join();
                     think_state = false;
 
+                    std::string pv;
+                    for (const Move &m : principal_variation)
+                        pv += ' ' + m.longform();
+
+                    send_cmd("info score " + score_to_uci(evaluation) + " hashfull " + std::to_string(tt.hashfull()) +
+                            (pv.empty() ? "" : " pv" + pv));
+                    send_cache_stats();
                     send_cmd("bestmove " + bestmove.longform());
-                    //send_cmd("info score cp " + std::to_string(static_cast<int>(evaluation*100)));
                 }
             }
         }
     }
 
+    // Search a fixed set of positions to a fixed depth. The node total is a
+    // signature of the search, and only changes when the search does.
+    void bench(int depth)
+    {
+        const std::array<std::string, 8> bench_positions =
+        {
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+            "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+            "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+            "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+            "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+            "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+            "r1bqk2r/pp2bppp/2n1pn2/2pp4/3P4/2PBPN2/PP1N1PPP/R1BQK2R b KQkq - 3 7",
+            "8/8/4k3/3p4/3P1K2/8/5P2/8 w - - 0 1"
+        };
+
+        std::uint64_t total_nodes = 0;
+        tt.clear();
+        eval_cache.clear();
+        for (SearchThread &t : threads)
+        {
+            t.pawn_table.clear();
+            t.history = {};
+        }
+        reset_thread_stats();
+
+        // The bench positions replace the game, put it back afterwards
+        const Board saved_board = board;
+        const std::vector<std::uint64_t> saved_z_list = z_list;
+
+        const auto ts = std::chrono::steady_clock::now();
+
+        for (const std::string &fen : bench_positions)
+        {
+            board = Board(fen);
+            z_list.clear();
+            z_list.push_back(board.get_zobrist());
+
+            eng.seed(1337);
+            nodes = 0;
+            depth_limit = depth;
+            infinite = false;
+
+            thinking = true;
+            think();
+
+            std::cout << fen << ": " << nodes << " nodes, bestmove " << bestmove.longform() << std::endl;
+
+            total_nodes += nodes;
+        }
+
+        depth_limit = 0;
+        board = saved_board;
+        z_list = saved_z_list;
+
+        const std::uint64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - ts).count();
+
+        std::cout << "===========================" << std::endl;
+        std::cout << "Total time (ms) : " << ms << std::endl;
+        std::cout << "Nodes searched  : " << total_nodes << std::endl;
+        std::cout << "Nodes/second    : " << (total_nodes*1000)/std::max(ms, std::uint64_t{1}) << std::endl;
+        send_cache_stats();
+
+        log << "bench depth " << depth << ": " << total_nodes << " nodes, " << ms << " ms" << std::endl;
+    }
+
+    void set_option(const std::string &name, const std::string &value)
+    {
+        log << "option " << name << " = " << value << std::endl;
+
+        if (name == "Threads")
+        {
+            threads.resize(std::clamp(std::stoi(value), 1, 512));
+        }
+        else if (name == "Hash")
+        {
+            tt.resize(std::stoul(value));
+        }
+        else if (name == "Clear Hash")
+        {
+            tt.clear();
+        }
+        else if (name == "Eval Cache")
+        {
+            eval_cache.resize(std::stoul(value));
+        }
+        else if (name == "EvalFile")
+        {
+            if (nnue::network.load(value))
+                send_cmd("info string loaded network " + value);
+            else
+                send_cmd("info string could not load network " + value);
+
+            board.refresh_incremental();
+            eval_cache.clear();
+        }
+        else if (name == "Use NNUE")
+        {
+            // Boards keep accumulators only while the network is in use
+            nnue::enabled = (value == "true");
+            board.refresh_incremental();
+            eval_cache.clear();
+        }
+    }
+
+    void send_cache_stats()
+    {
+        const auto send_stats = [&](const std::string &name, std::uint64_t hits, std::uint64_t probes)
+        {
+            if (probes == 0)
+                return;
+
+            send_cmd("info string " + name + ' ' + std::to_string(hits) + '/' + std::to_string(probes) +
+                    " (" + std::to_string((hits*100)/probes) + "%)");
+        };
+
+        std::uint64_t tt_hits = 0, tt_probes = 0;
+        std::uint64_t eval_hits = 0, eval_probes = 0;
+        std::uint64_t pawn_hits = 0, pawn_probes = 0;
+        std::uint64_t lazy_cutoffs = 0, lazy_evals = 0;
+        std::uint64_t aspiration_searches = 0, fail_highs = 0, fail_lows = 0;
+        std::uint64_t cutoffs = 0, first_move_cutoffs = 0;
+        std::uint64_t null_moves = 0, null_cutoffs = 0;
+        std::uint64_t reduced_moves = 0, reduced_researches = 0;
+
+        for (const SearchThread &t : threads)
+        {
+            tt_hits += t.tt_hits;
+            tt_probes += t.tt_probes;
+            eval_hits += t.eval_hits;
+            eval_probes += t.eval_probes;
+            pawn_hits += t.pawn_table.get_hits();
+            pawn_probes += t.pawn_table.get_probes();
+            lazy_cutoffs += t.lazy_cutoffs;
+            lazy_evals += t.lazy_evals;
+            aspiration_searches += t.aspiration_searches;
+            fail_highs += t.aspiration_fail_highs;
+            fail_lows += t.aspiration_fail_lows;
+            cutoffs += t.cutoffs;
+            first_move_cutoffs += t.first_move_cutoffs;
+            null_moves += t.null_moves;
+            null_cutoffs += t.null_cutoffs;
+            reduced_moves += t.reduced_moves;
+            reduced_researches += t.reduced_researches;
+        }
+
+        send_stats("transposition table", tt_hits, tt_probes);
+        send_stats("eval cache", eval_hits, eval_probes);
+        send_stats("pawn table", pawn_hits, pawn_probes);
+        send_stats("lazy eval cutoffs", lazy_cutoffs, lazy_evals);
+        send_stats("first move cutoffs", first_move_cutoffs, cutoffs);
+        send_stats("null move cutoffs", null_cutoffs, null_moves);
+        send_stats("late move re-searches", reduced_researches, reduced_moves);
+
+        if (aspiration_searches != 0)
+        {
+            send_cmd("info string aspiration re-searches " + std::to_string(fail_highs + fail_lows) +
+                    " in " + std::to_string(aspiration_searches) + " searches (" +
+                    std::to_string(fail_highs) + " fail high, " + std::to_string(fail_lows) + " fail low)");
+        }
+    }
+
+    void reset_thread_stats()
+    {
+        for (SearchThread &t : threads)
+        {
+            t.tt_probes = 0;
+            t.tt_hits = 0;
+            t.eval_probes = 0;
+            t.eval_hits = 0;
+            t.pawn_table.reset_stats();
+            t.lazy_evals = 0;
+            t.lazy_cutoffs = 0;
+            t.aspiration_searches = 0;
+            t.aspiration_fail_highs = 0;
+            t.aspiration_fail_lows = 0;
+            t.cutoffs = 0;
+            t.first_move_cutoffs = 0;
+            t.null_moves = 0;
+            t.null_cutoffs = 0;
+            t.reduced_moves = 0;
+            t.reduced_researches = 0;
+        }
+    }
+
     void send_cmd(std::string s)
     {
         log << "< " << s << std::endl;
@@ -11,146 +11,256 @@ public:
         start();
     }
 
-    MoveList movelist;
-
-    double alphaBetaMax(Board& base, double alpha, double beta, int depthleft, std::vector<std::uint64_t> &zob_list)
+    Score alphaBetaMax(SearchThread &t, Board& base, Score alpha, Score beta, int depthleft, int ply, std::vector<std::uint64_t> &zob_list)
     {
-        base.get_moves(movelist, zob_list);
+        t.nodes++;
+
+        // Own list per ply, the children would overwrite a shared one
+        MoveList moves;
+        base.get_moves(moves, zob_list);
 
-        if (depthleft == 0)
+        // The thread's stack ends at max_ply
+        if (depthleft == 0 || ply >= max_ply)
         {
-            return base.adv_eval(movelist);
+            return lazy_eval(t, base, moves, ply, alpha, beta);
         }
 
-        if (movelist.size() == 0)
+        if (moves.size() == 0)
         {
-            return base.adv_eval(movelist);
+            return cached_eval(t, base, moves, ply);
         }
 
-        for (int i = 0; i < movelist.size(); i++)
+        const std::uint64_t key = base.get_zobrist();
+        Score tt_score;
+        Move tt_move;
+        if (tt_cutoff(t, key, depthleft, ply, alpha, beta, tt_score, tt_move))
+            return tt_score;
+
+        // Null move. If passing still fails high at reduced depth, a real move
+        // would too.
+        if (null_move_allowed(t, base, depthleft) && lazy_eval(t, base, moves, ply, alpha, beta) >= beta)
         {
-            Board node(base, movelist.at(i));
+            const int reduction = null_move_reduction(depthleft);
+
+            Board node(base);
+            node.pass();
+
+            t.null_moves++;
+
+            zob_list.push_back(node.get_zobrist());
+            Score score = alphaBetaMin(t, node, beta - 1, beta, depthleft - 1 - reduction, ply + 1, zob_list);
+            zob_list.pop_back();
+
+            if (score >= beta && null_move_verify(base))
+            {
+                t.no_null = true;
+                score = alphaBetaMax(t, base, beta - 1, beta, depthleft - reduction, ply, zob_list);
+                t.no_null = false;
+            }
+
+            if (stopped())
+                return 0;
+
+            if (score >= beta)
+            {
+                t.null_cutoffs++;
+                return beta;
+            }
+        }
+
+        // Table move first
+        score_moves(t, base, moves, ply, tt_move);
+
+        Move best;
+
+        for (std::uint8_t i = 0; i < moves.size(); i++)
+        {
+            pick_move(t, moves, ply, i);
+            Board node(base, moves.at(i));
+
+            if (see_prune(t, base, node, ply, depthleft, moves.at(i), i))
+                continue;
 
             std::uint64_t zob = node.get_zobrist();
             zob_list.push_back(zob);
-            double score = alphaBetaMin(node, alpha, beta, depthleft - 1, zob_list);
+
+            // Late moves first get a reduced null window search, and the full
+            // one only if they beat alpha
+            const int reduction = late_move_reduction(t, base, node, ply, depthleft, i);
+            Score score = alpha + 1;
+
+            if (reduction != 0)
+            {
+                t.reduced_moves++;
+                score = alphaBetaMin(t, node, alpha, alpha + 1, depthleft - 1 - reduction, ply + 1, zob_list);
+
+                if (score > alpha)
+                    t.reduced_researches++;
+            }
+
+            if (score > alpha)
+                score = alphaBetaMin(t, node, alpha, beta, depthleft - 1, ply + 1, zob_list);
+
             zob_list.pop_back();
 
+            if (stopped())
+                return 0;
+
             if(score >= beta)
+            {
+                record_cutoff(t, base, ply, depthleft, moves.at(i), i);
+                tt.store(key, ply, moves.at(i), beta, depthleft, Bound::Lower);
                 return beta;   // fail hard beta-cutoff
+            }
             if(score > alpha)
+            {
                 alpha = score; // alpha acts like max in MiniMax
+                best = moves.at(i);
+            }
         }
+
+        tt.store(key, ply, best, alpha, depthleft, (best.data != 0) ? Bound::Exact : Bound::Upper);
+
         return alpha;
     }
 
-    double alphaBetaMin(Board& base, double alpha, double beta, int depthleft, std::vector<std::uint64_t> &zob_list)
+    Score alphaBetaMin(SearchThread &t, Board& base, Score alpha, Score beta, int depthleft, int ply, std::vector<std::uint64_t> &zob_list)
     {
-        base.get_moves(movelist);
+        t.nodes++;
+
+        // Own list per ply, the children would overwrite a shared one
+        MoveList moves;
+        base.get_moves(moves);
 
-        if (depthleft == 0)
+        // The thread's stack ends at max_ply
+        if (depthleft == 0 || ply >= max_ply)
         {
-            return base.adv_eval(movelist);
+            return lazy_eval(t, base, moves, ply, alpha, beta);
         }
 
-        if (movelist.size() == 0)
+        if (moves.size() == 0)
         {
-            return base.adv_eval(movelist);
+            return cached_eval(t, base, moves, ply);
         }
 
-        for (int i = 0; i < movelist.size(); i++)
+        const std::uint64_t key = base.get_zobrist();
+        Score tt_score;
+        Move tt_move;
+        if (tt_cutoff(t, key, depthleft, ply, alpha, beta, tt_score, tt_move))
+            return tt_score;
+
+        // Null move. If passing still fails low at reduced depth, a real move
+        // would too.
+        if (null_move_allowed(t, base, depthleft) && lazy_eval(t, base, moves, ply, alpha, beta) <= alpha)
         {
-            Board node(base, movelist.at(i));
+            const int reduction = null_move_reduction(depthleft);
+
+            Board node(base);
+            node.pass();
+
+            t.null_moves++;
+
+            zob_list.push_back(node.get_zobrist());
+            Score score = alphaBetaMax(t, node, alpha, alpha + 1, depthleft - 1 - reduction, ply + 1, zob_list);
+            zob_list.pop_back();
+
+            if (score <= alpha && null_move_verify(base))
+            {
+                t.no_null = true;
+                score = alphaBetaMin(t, base, alpha, alpha + 1, depthleft - reduction, ply, zob_list);
+                t.no_null = false;
+            }
+
+            if (stopped())
+                return 0;
+
+            if (score <= alpha)
+            {
+                t.null_cutoffs++;
+                return alpha;
+            }
+        }
+
+        // Table move first
+        score_moves(t, base, moves, ply, tt_move);
+
+        Move best;
+
+        for (std::uint8_t i = 0; i < moves.size(); i++)
+        {
+            pick_move(t, moves, ply, i);
+            Board node(base, moves.at(i));
+
+            if (see_prune(t, base, node, ply, depthleft, moves.at(i), i))
+                continue;
 
             std::uint64_t zob = node.get_zobrist();
             zob_list.push_back(zob);
-            double score = alphaBetaMax(node, alpha, beta, depthleft - 1, zob_list);
+
+            // Late moves first get a reduced null window search, and the full
+            // one only if they beat beta
+            const int reduction = late_move_reduction(t, base, node, ply, depthleft, i);
+            Score score = beta - 1;
+
+            if (reduction != 0)
+            {
+                t.reduced_moves++;
+                score = alphaBetaMax(t, node, beta - 1, beta, depthleft - 1 - reduction, ply + 1, zob_list);
+
+                if (score < beta)
+                    t.reduced_researches++;
+            }
+
+            if (score < beta)
+                score = alphaBetaMax(t, node, alpha, beta, depthleft - 1, ply + 1, zob_list);
+
             zob_list.pop_back();
 
+            if (stopped())
+                return 0;
+
             if(score <= alpha)
+            {
+                record_cutoff(t, base, ply, depthleft, moves.at(i), i);
+                tt.store(key, ply, moves.at(i), alpha, depthleft, Bound::Upper);
                 return alpha; // fail hard alpha-cutoff
+            }
             if(score < beta)
+            {
                 beta = score; // beta acts like min in MiniMax
+                best = moves.at(i);
+            }
         }
+
+        tt.store(key, ply, best, beta, depthleft, (best.data != 0) ? Bound::Exact : Bound::Lower);
+
         return beta;
     }
 
     void think() override
+    {
+        search_threads([&](SearchThread &t) { iterate(t); });
+
+        // End of function
+        thinking = false;
+    }
+
+    // Iterative deepening on one thread. Odd helpers search one ply deeper
+    // than the main thread, so that the threads spread over two depths.
+    void iterate(SearchThread &t)
     {
         // Default white
         int turn = 1;
-        if(board.get_turn() == Color::Black)
+        if(t.board.get_turn() == Color::Black)
             turn = -1;
 
-        std::uniform_int_distribution<std::uint8_t> dist(0,1);
-
-        const std::function<void(BoardTree&)> minimax = [&](BoardTree &base)
-        {
-            if (base.expanded && (base.nodes.size() != 0))
-            {
-                for (BoardTree &node : base.nodes)
-                {
-                    minimax(node);
-                }
-
-                if (base.board.get_turn() == Color::White)
-                {
-                    double eval = -1000000;
-                    Move best;
-
-                    for (const BoardTree &node : base.nodes)
-                    {
-                        if (
-                                (node.evaluation > eval) ||
-                                (node.evaluation == eval && dist(eng) == 1)
-                           )
-                        {
-                            eval = node.evaluation;
-                            best = node.move;
-                        }
-                    }
-                    base.evaluation = eval;
-                    base.bestmove = best;
-                }
-                else
-                {
-                    double eval = 1000000;
-                    Move best;
-
-                    for (const BoardTree &node : base.nodes)
-                    {
-                        if (
-                                (node.evaluation < eval) ||
-                                (node.evaluation == eval && dist(eng) == 1)
-                           )
-                        {
-                            eval = node.evaluation;
-                            best = node.move;
-                        }
-                    }
-
-                    base.evaluation = eval;
-                    base.bestmove = best;
-                }
-            }
-            else
-            {
-                base.board.get_moves(movelist);
-                base.evaluation = base.board.adv_eval(movelist);
-            }
-            return;
-        };
-
-        // Create tree structure
-        BoardTree root(board);
-
         std::chrono::duration<double, std::milli> previous_ply(0);
         std::chrono::duration<double, std::milli> last_ply(0);
         int ply = 1;
 
         std::uint64_t time_left = w_time;
         std::uint64_t time_inc = w_inc;
-        if (board.get_turn() == Color::Black)
+        if (t.board.get_turn() == Color::Black)
         {
             time_left = b_time;
             time_inc = b_inc;
@@ -160,44 +270,100 @@ public:
         std::uint64_t exp_time = 0;
 
         MoveList root_moves;
-        board.get_moves(root_moves);
+        t.board.get_moves(root_moves);
         std::vector<Board> root_boards;
         for (int i = 0; i < root_moves.size(); i++)
         {
-            root_boards.emplace_back(board, root_moves.at(i));
+            root_boards.emplace_back(t.board, root_moves.at(i));
         }
 
-        while (max_time - time_spent > exp_time)
+        std::array<Score, 2> previous = {0, 0};
+
+        while (
+                !stopped() && (
+                (depth_limit != 0) ?
+                (ply <= depth_limit) :
+                ((time_spent + exp_time < max_time) && (ply < max_ply)))
+              )
         {
             auto tp = std::chrono::high_resolution_clock::now();
 
-            std::vector<double> evals(root_moves.size());
-            for (int i = 0; i < root_moves.size(); i++)
+            const int depth = std::min(ply + (t.id & 1), max_ply - 1);
+
+            // Aspiration window for the side to move, see AlphaBetaEngine
+            Score delta = aspiration_window;
+            Score lo = -infinite_score;
+            Score hi = infinite_score;
+
+            if (ply > 2 && !is_mate_score(previous[ply & 1]))
             {
-                if (board.get_turn() == Color::White)
-                    evals.at(i) = alphaBetaMin(root_boards.at(i), -100000, 100000, ply, z_list);
-                else
-                    evals.at(i) = alphaBetaMax(root_boards.at(i), -100000, 100000, ply, z_list);
+                lo = std::max(previous[ply & 1] - delta, -infinite_score);
+                hi = std::min(previous[ply & 1] + delta, infinite_score);
+                t.aspiration_searches++;
             }
 
-            double best_move = 0;
-            double best_eval = evals.at(0)*turn;
+            std::vector<Score> evals(root_moves.size());
+            int best_move = 0;
+            Score best_eval = 0;
 
-            for (int i = 1; i < root_moves.size(); i++)
+            while (1)
             {
-                if (evals.at(i)*turn > best_eval)
+                for (int i = 0; i < root_moves.size(); i++)
+                {
+                    if (t.board.get_turn() == Color::White)
+                        evals.at(i) = alphaBetaMin(t, root_boards.at(i), lo, hi, depth, 1, t.z_list);
+                    else
+                        evals.at(i) = alphaBetaMax(t, root_boards.at(i), -hi, -lo, depth, 1, t.z_list);
+                }
+
+                if (stopped())
+                    break;
+
+                best_move = 0;
+                best_eval = evals.at(0)*turn;
+
+                for (int i = 1; i < root_moves.size(); i++)
                 {
-                    best_move = i;
-                    best_eval = evals.at(i)*turn;
+                    if (evals.at(i)*turn > best_eval)
+                    {
+                        best_move = i;
+                        best_eval = evals.at(i)*turn;
+                    }
+                }
+
+                delta *= 2;
+
+                if (best_eval <= lo && lo > -infinite_score)
+                {
+                    t.aspiration_fail_lows++;
+                    lo = std::max(best_eval - delta, -infinite_score);
+                }
+                else if (best_eval >= hi && hi < infinite_score)
+                {
+                    t.aspiration_fail_highs++;
+                    hi = std::min(best_eval + delta, infinite_score);
+                }
+                else
+                {
+                    break;
                 }
             }
 
+            if (stopped())
+                break;
+
+            previous[ply & 1] = best_eval;
+
             std::chrono::duration<double> dur = std::chrono::high_resolution_clock::now() - tp;
 
-            bestmove = root_moves.at(best_move);
-            evaluation = best_eval;
+            if (t.id == 0)
+            {
+                bestmove = root_moves.at(best_move);
+                evaluation = best_eval;
+            }
 
-            if (evaluation > 150)
+            // Stop once a forced mate is found
+            if (best_eval >= mate_bound)
             {
                 break;
             }
@@ -208,9 +374,6 @@ public:
 
             exp_time = std::min(static_cast<double>(last_ply.count()/previous_ply.count()), double{30})*last_ply.count();
         }
-
-        // End of function
-        thinking = false;
     }
 };
 
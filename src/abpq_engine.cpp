@@ -1,6 +1,6 @@
-#include "UCIEngine.hpp"
+#include "AlphaBetaEngine.hpp"
 
-class ABPQEngine : public UCIEngine
+class ABPQEngine : public AlphaBetaEngine
 {
 public:
     ABPQEngine()
@@ -11,257 +11,102 @@ public:
         start();
     }
 
-    MoveList movelist;
-
-    double alphaBetaMax(BoardTree& base, double alpha, double beta, int depthleft, std::vector<std::uint64_t> &zob_list)
+    Score horizon(SearchThread &t, int ply, Score alpha, Score beta) override
     {
-        base.board.get_moves(movelist);
-
-        if (depthleft == 0)
-        {
-            //return base.board.adv_eval(movelist);
-            return quiesce(base, alpha, beta, 1);
-        }
-
-        base.expand(movelist, zob_list, 1);
-
-        if(base.nodes.size() == 0)
-            return base.board.adv_eval(movelist);
-
-        for (BoardTree &node : base.nodes)
-        {
-            std::uint64_t zob = node.board.get_zobrist();
-            zob_list.push_back(zob);
-            double score = alphaBetaMin(node, alpha, beta, depthleft - 1, zob_list);
-            zob_list.pop_back();
-
-            if(score >= beta)
-                return beta;   // fail hard beta-cutoff
-            if(score > alpha)
-                alpha = score; // alpha acts like max in MiniMax
-        }
-        return alpha;
+        return quiesce(t, alpha, beta, ply);
     }
 
-    double alphaBetaMin(BoardTree& base, double alpha, double beta, int depthleft, std::vector<std::uint64_t> &zob_list)
+    // Captures and promotions until the position is quiet, the side to move
+    // can stand pat on the static score. All evasions are searched when in
+    // check, as standing pat is not an option there.
+    Score quiesce(SearchThread &t, Score alpha, Score beta, int ply)
     {
-        base.board.get_moves(movelist);
+        t.stack[ply].pv_length = 0;
 
-        if (depthleft == 0)
-        {
-           // return -base.board.adv_eval(movelist);
-            return quiesce(base, alpha, beta, 1);
+        const Board &pos = t.stack[ply].board;
+        MoveList &moves = t.stack[ply].moves;
 
-        }
+        const bool in_check = pos.get_checkers() != 0;
 
-        base.expand(movelist, zob_list, 1);
+        if (in_check)
+            pos.get_moves(moves);
+        else
+            pos.get_captures(moves);
 
-        if(base.nodes.size() == 0)
-            return base.board.adv_eval(movelist);
+        if (moves.is_checkmate || moves.is_stalemate || ply == max_ply)
+            return side_eval(t, pos, moves, ply, alpha, beta);
 
-        for (BoardTree &node : base.nodes)
-        {
-            std::uint64_t zob = node.board.get_zobrist();
-            zob_list.push_back(zob);
-            double score = alphaBetaMax(node, alpha, beta, depthleft - 1, zob_list);
-            zob_list.pop_back();
+        Score stand_pat = -infinite_score;
 
-            if(score <= alpha)
-                return alpha; // fail hard alpha-cutoff
-            if(score < beta)
-                beta = score; // beta acts like min in MiniMax
-        }
-        return beta;
-    }
-
-
-    //Look at nodes which involves captures.
-    double quiesce(BoardTree& base, double alpha, double beta, int depthleft)
-    {
-        if(depthleft == 0)
+        if (!in_check)
         {
-            return alpha;
-        }
-        base.board.get_moves(movelist);
-        BoardTree& base_copy =base;
+            stand_pat = side_eval(t, pos, moves, ply, alpha, beta);
 
-        double stand_pat = base.board.adv_eval(movelist);
-
-        if(stand_pat >= beta)
-            return stand_pat; // some say that returning beta will make it kill itself --> https://stackoverflow.com/questions/48846642/is-there-something-wrong-with-my-quiescence-search
-        if(alpha < stand_pat)
-            alpha = stand_pat;
-///////////////////////////////////////// DELTA PRUUNIN ////////////////////
-        // get a "stand pat" score
-
-        // double stand_pat = base.board.adv_eval(movelist);
-
-        // check if it causes a beta cutoff
+            if (stand_pat >= beta)
+                return beta;
 
-        if( stand_pat >= beta )
-           return beta;
+            // Delta pruning, not even winning a queen (and promoting) gets back to the window
+            const Bitboard seventh_rank = (pos.get_turn() == Color::White) ? rank_8 >> 8 : rank_1 << 8;
 
-        // The next three lines test if alpha can be improved by greatest
-        // possible material swing.
+            Score BIG_DELTA = 900; // queen value
+            if ((pos.get_bitboard(pos.get_turn(), Piece::Pawn) & seventh_rank) != 0)
+                BIG_DELTA += 700;
 
-        int BIG_DELTA = 9; // queen value
-        if ( base.board.movetohere.get_type()==MoveSpecial::Promotion ) BIG_DELTA += 7;
+            if (stand_pat + BIG_DELTA < alpha)
+                return alpha;
 
-        if ( stand_pat < alpha - BIG_DELTA ) {
-           return alpha;
+            if (stand_pat > alpha)
+                alpha = stand_pat;
         }
 
-        if( alpha < stand_pat )
-           alpha = stand_pat;
-
-
-///////////////////////////////////////////////// END ///////////////////////
-//One more hint: usually, Quiscence search uses a separate move generator that generates only captures,
-//checks and pawn promotions (such a generator is simpler and faster than the normal one).
+        score_moves(t, pos, moves, ply, Move());
 
+        Board &child = t.stack[ply+1].board;
 
+        for (std::uint8_t i = 0; i < moves.size(); i++)
+        {
+            pick_move(t, moves, ply, i);
+            const Move m = moves.at(i);
 
-            base.expand(movelist, 1);
-            double score = stand_pat;
-            for (BoardTree &node : base.nodes)
+            if (!in_check && m.get_type() != MoveSpecial::Promotion)
             {
-                if(base.board.typetohere == MoveType::Capture)
-                    {
+                const Score victim = (m.get_type() == MoveSpecial::EnPassant) ? eval_tables::piece_values[0] : piece_value(pos, m.get_to());
 
-                   // base.expand(movelist, 1);
-                    score = -1.0 * quiesce(node, -beta, -alpha, depthleft-1);
-                    base=base_copy;
+                // Delta pruning per move, the victim and a margin do not reach alpha
+                if (stand_pat + victim + delta_margin <= alpha)
+                    continue;
 
-                    }
+                // Captures that lose material by SEE, scored below zero by
+                // score_moves
+                if (t.stack[ply].move_scores[i] < 0)
+                    continue;
+            }
 
-            // undo last move --> restore state is this possible, i dont think it works without.
-            // there should be a limit in how deep it searches, because right  now i think it keeps searching.
+            child = pos;
+            child.perform_move(m);
 
+            t.nodes++;
+            const Score score = -quiesce(t, -beta, -alpha, ply+1);
 
-            if(score >= beta)
+            if (stopped())
+                return 0;
 
+            if (score >= beta)
                 return beta;
-
-            if(score > alpha)
-
-               alpha = score;
-            }
+            if (score > alpha)
+                alpha = score;
+        }
 
         return alpha;
     }
 
-    void think() override
-    {
-        // Default white
-        int turn = 1;
-        if(board.get_turn() == Color::Black)
-            turn = -1;
-
-        std::uniform_int_distribution<std::uint8_t> dist(0,1);
-
-        const std::function<void(BoardTree&)> minimax = [&](BoardTree &base)
-        {
-            if (base.expanded && (base.nodes.size() != 0))
-            {
-                for (BoardTree &node : base.nodes)
-                {
-                    minimax(node);
-                }
-
-                if (base.board.get_turn() == Color::White)
-                {
-                    double eval = -1000000;
-                    Move best;
-
-                    for (const BoardTree &node : base.nodes)
-                    {
-                        if (
-                                (node.evaluation > eval) ||
-                                (node.evaluation == eval && dist(eng) == 1)
-                           )
-                        {
-                            eval = node.evaluation;
-                            best = node.move;
-                        }
-                    }
-                    base.evaluation = eval;
-                    base.bestmove = best;
-                }
-                else
-                {
-                    double eval = 1000000;
-                    Move best;
-
-                    for (const BoardTree &node : base.nodes)
-                    {
-                        if (
-                                (node.evaluation < eval) ||
-                                (node.evaluation == eval && dist(eng) == 1)
-                           )
-                        {
-                            eval = node.evaluation;
-                            best = node.move;
-                        }
-                    }
-
-                    base.evaluation = eval;
-                    base.bestmove = best;
-                }
-            }
-            else
-            {
-                base.board.get_moves(movelist);
-                base.evaluation = base.board.adv_eval(movelist);
-            }
-            return;
-        };
-
-        // Create tree structure
-        BoardTree root(board);
-
-        std::chrono::duration<double, std::milli> previous_ply(0);
-        std::chrono::duration<double, std::milli> last_ply(0);
-        int ply = 1;
+private:
+    // Positional swing a capture may add on top of its victim
+    static constexpr Score delta_margin = 200;
 
-        std::uint64_t time_left = w_time;
-        std::uint64_t time_inc = w_inc;
-        if (board.get_turn() == Color::Black)
-        {
-            time_left = b_time;
-            time_inc = b_inc;
-        }
-
-        std::uint64_t max_time = std::min(time_inc + time_left/4, std::uint64_t{30000});
-        std::uint64_t exp_time = 0;
-
-        while ((max_time - time_spent > exp_time) && (ply <= 5))
-        {
-            auto tp = std::chrono::high_resolution_clock::now();
-
-            if (root.board.get_turn() == Color::White)
-                alphaBetaMax(root, -100000, 100000, ply, z_list);
-            else
-                alphaBetaMin(root, -100000, 100000, ply, z_list);
-
-            //Perform search looking at capture nodes.
-            //quiesce(root, 10000, -10000);
-
-            minimax(root);
-
-            std::chrono::duration<double> dur = std::chrono::high_resolution_clock::now() - tp;
-
-            bestmove = root.bestmove;
-            evaluation = root.evaluation*turn;
-
-            ply++;
-            previous_ply = last_ply;
-            last_ply = dur;
-
-            exp_time = std::min(static_cast<double>(last_ply.count()/previous_ply.count()), double{30})*last_ply.count();
-        }
-
-        // End of function
-        thinking = false;
+    static Score piece_value(const Board &pos, Square sq)
+    {
+        return eval_tables::piece_values[static_cast<std::uint8_t>(pos.get_piece(sq))];
     }
 };
 
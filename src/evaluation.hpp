@@ -0,0 +1,205 @@
+#ifndef EVALUATION_HPP
+#define EVALUATION_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+// Scores are integer centipawns. Mate scores count down from mate_score by the
+// number of plies to the mate, so a shorter mate is always preferred and the
+// distance survives being stored in 16 bits.
+using Score = std::int32_t;
+
+constexpr Score mate_score = 32000;
+constexpr Score max_ply = 256;
+constexpr Score mate_bound = mate_score - max_ply; // Anything beyond is a mate
+constexpr Score infinite_score = mate_score + 1;
+
+// Score of mating / being mated ply plies from the root
+constexpr Score mate_in(int ply)
+{
+    return mate_score - ply;
+}
+
+constexpr Score mated_in(int ply)
+{
+    return -mate_score + ply;
+}
+
+constexpr bool is_mate_score(Score s)
+{
+    return (s >= mate_bound) || (s <= -mate_bound);
+}
+
+// UCI score string, "cp <x>" or "mate <moves>" (negative when being mated)
+inline std::string score_to_uci(Score s)
+{
+    if (s >= mate_bound)
+        return "mate " + std::to_string((mate_score - s + 1)/2);
+
+    if (s <= -mate_bound)
+        return "mate " + std::to_string(-(mate_score + s)/2);
+
+    return "cp " + std::to_string(s);
+}
+
+// Created based on "Simplified Evalution Function" on Chess Programming Wiki.
+// Tables are from white's point of view with a8 first, index as (7-y)*8+x for
+// white and y*8+x for black (reflected, not rotated).
+namespace eval_tables
+{
+    // Piece values
+    constexpr std::array<Score, 6> piece_values = {100, 320, 330, 500, 900, 20000};
+
+    // How far the terms that are not kept incrementally are assumed to move
+    // the score, for lazy evaluation. A heuristic, not a bound: passed pawns,
+    // mobility and king attacks can add up to more. Measured with "perft
+    // lazycheck" and on random games they stay below 350.
+    constexpr Score lazy_margin = 400;
+
+    // Pawn Piece-Square Table
+    constexpr std::array<Score, 64> pawn_ps =
+    {
+          0,  0,  0,  0,  0,  0,  0,  0,
+         50, 50, 50, 50, 50, 50, 50, 50,
+         10, 10, 20, 30, 30, 20, 10, 10,
+          5,  5, 10, 25, 25, 10,  5,  5,
+          0,  0,  0, 20, 20,  0,  0,  0,
+          5, -5,-10,  0,  0,-10, -5,  5,
+          5, 10, 10,-20,-20, 10, 10,  5,
+          0,  0,  0,  0,  0,  0,  0,  0
+    };
+
+    // Knight Piece-Square Table
+    constexpr std::array<Score, 64> knight_ps =
+    {
+        -50,-40,-30,-30,-30,-30,-40,-50,
+        -40,-20,  0,  0,  0,  0,-20,-40,
+        -30,  0, 10, 15, 15, 10,  0,-30,
+        -30,  5, 15, 20, 20, 15,  5,-30,
+        -30,  0, 15, 20, 20, 15,  0,-30,
+        -30,  5, 10, 15, 15, 10,  5,-30,
+        -40,-20,  0,  5,  5,  0,-20,-40,
+        -50,-40,-30,-30,-30,-30,-40,-50
+    };
+
+    // Bishop Piece-Square Table
+    constexpr std::array<Score, 64> bishop_ps =
+    {
+        -20,-10,-10,-10,-10,-10,-10,-20,
+        -10,  0,  0,  0,  0,  0,  0,-10,
+        -10,  0,  5, 10, 10,  5,  0,-10,
+        -10,  5,  5, 10, 10,  5,  5,-10,
+        -10,  0, 10, 10, 10, 10,  0,-10,
+        -10, 10, 10, 10, 10, 10, 10,-10,
+        -10,  5,  0,  0,  0,  0,  5,-10,
+        -20,-10,-10,-10,-10,-10,-10,-20
+    };
+
+    // Rook Piece-Square Table
+    constexpr std::array<Score, 64> rook_ps =
+    {
+          0,  0,  0,  0,  0,  0,  0,  0,
+          5, 10, 10, 10, 10, 10, 10,  5,
+         -5,  0,  0,  0,  0,  0,  0, -5,
+         -5,  0,  0,  0,  0,  0,  0, -5,
+         -5,  0,  0,  0,  0,  0,  0, -5,
+         -5,  0,  0,  0,  0,  0,  0, -5,
+         -5,  0,  0,  0,  0,  0,  0, -5,
+          0,  0,  0,  5,  5,  0,  0,  0
+    };
+
+    // Queen Piece-Square Table
+    constexpr std::array<Score, 64> queen_ps =
+    {
+        -20,-10,-10, -5, -5,-10,-10,-20,
+        -10,  0,  0,  0,  0,  0,  0,-10,
+        -10,  0,  5,  5,  5,  5,  0,-10,
+         -5,  0,  5,  5,  5,  5,  0, -5,
+          0,  0,  5,  5,  5,  5,  0, -5,
+        -10,  5,  5,  5,  5,  5,  0,-10,
+        -10,  0,  5,  0,  0,  0,  0,-10,
+        -20,-10,-10, -5, -5,-10,-10,-20
+    };
+
+    // King middle-game Piece-Square Table
+    constexpr std::array<Score, 64> king_middle_ps =
+    {
+        -30,-40,-40,-50,-50,-40,-40,-30,
+        -30,-40,-40,-50,-50,-40,-40,-30,
+        -30,-40,-40,-50,-50,-40,-40,-30,
+        -30,-40,-40,-50,-50,-40,-40,-30,
+        -20,-30,-30,-40,-40,-30,-30,-20,
+        -10,-20,-20,-20,-20,-20,-20,-10,
+         20, 20,  0,  0,  0,  0, 20, 20,
+         20, 30, 10,  0,  0, 10, 30, 20
+    };
+
+    // King end-game Piece-Square Table
+    constexpr std::array<Score, 64> king_end_ps =
+    {
+        -50,-40,-30,-20,-20,-30,-40,-50,
+        -30,-20,-10,  0,  0,-10,-20,-30,
+        -30,-10, 20, 30, 30, 20,-10,-30,
+        -30,-10, 30, 40, 40, 30,-10,-30,
+        -30,-10, 30, 40, 40, 30,-10,-30,
+        -30,-10, 20, 30, 30, 20,-10,-30,
+        -30,-30,  0,  0,  0,  0,-30,-30,
+        -50,-30,-30,-30,-30,-30,-30,-50
+    };
+
+    // Game phase, 24 with all pieces on the board and 0 with only pawns
+    constexpr std::array<int, 6> phase_weights = {0, 1, 1, 2, 4, 0};
+    constexpr int phase_max = 24;
+
+    // Material plus piece-square values from the tables above
+    constexpr std::array<std::array<Score, 64>, 6> make_psqt(bool endgame)
+    {
+        std::array<std::array<Score, 64>, 6> t = {};
+
+        const std::array<const std::array<Score, 64>*, 6> ps =
+        {
+            &pawn_ps, &knight_ps, &bishop_ps, &rook_ps, &queen_ps,
+            endgame ? &king_end_ps : &king_middle_ps
+        };
+
+        for (std::uint8_t p = 0; p < 6; p++)
+            for (std::uint8_t sq = 0; sq < 64; sq++)
+                t[p][sq] = piece_values[p] + (*ps[p])[sq ^ 56];
+
+        return t;
+    }
+}
+
+// The terms below are what the tune target optimises. It writes them out as
+// tuned_eval.hpp, which replaces them when built with TUNED_EVAL.
+#ifdef TUNED_EVAL
+#include "tuned_eval.hpp"
+#else
+namespace eval_tables
+{
+    constexpr Score bishop_pair = 35;
+    constexpr Score doubled_pawns = 35;
+    constexpr Score isolated_pawn = 15;
+
+    // Per square attacked that is neither own nor defended by an enemy pawn.
+    // Queens count as both diagonal and orthogonal sliders.
+    constexpr Score mobility_knight = 4;
+    constexpr Score mobility_diagonal = 3;
+    constexpr Score mobility_orthogonal = 2;
+
+    // Per enemy king zone square attacked, once each by knights, diagonal and
+    // orthogonal sliders. Middle game only.
+    constexpr Score king_zone_attack = 8;
+
+    // Passed pawn bonus by rank, from the pawn's own side
+    constexpr std::array<Score, 8> passed_pawn = {0, 10, 10, 20, 35, 60, 100, 0};
+
+    // Material plus piece-square value of a white piece, indexed by piece and
+    // board square (y*8+x). Black uses the square flipped vertically.
+    constexpr std::array<std::array<Score, 64>, 6> psqt_mg = make_psqt(false);
+    constexpr std::array<std::array<Score, 64>, 6> psqt_eg = make_psqt(true);
+}
+#endif
+
+#endif
@@ -31,9 +31,16 @@ public:
         BoardTree root_node(board);
 
         // MCTS
+        // There is no depth in MCTS, so a fixed depth search runs a fixed
+        // number of playouts per depth instead
         uint64_t time_max = 5000;
-        while((time_spent < time_max) && !emergency_brake)
+        int playout_max = depth_limit*1000;
+        while(
+                ((depth_limit != 0) ? (root_node.visitcount < playout_max) : (time_spent < time_max))
+                && !emergency_brake)
         {
+            nodes++;
+
             // === Selection ===
             BoardTree* promising_node = select_node(&root_node);
 
@@ -158,7 +165,7 @@ public:
             return 0;
        
         // Save start eval
-        double eval_start = tmp_board.adv_eval(tmp_moves);
+        Score eval_start = tmp_board.adv_eval(tmp_moves);
 
         // Find end state (win/lose/draw/max iterations)
         int max_moves = 15;
@@ -181,11 +188,11 @@ public:
         }
         
         // Evaluate end state (this needs turn bias?)
-        double eval = tmp_board.adv_eval(tmp_moves);    // Rough double to int conversion
+        Score eval = tmp_board.adv_eval(tmp_moves);
         eval -= eval_start;                             // Optional: relative evaluation
         
         // Translate evaluation
-        double padding = 0.5;
+        Score padding = 50;
         int eval_norm = 0;
         if (eval > padding)
             eval_norm = 1;
@@ -24,18 +24,20 @@ public:
 
         std::uniform_int_distribution<std::uint8_t> dist(0,1);
 
-        const std::function<void(BoardTree&)> minimax = [&](BoardTree &base)
+        const std::function<void(BoardTree&, int)> minimax = [&](BoardTree &base, int ply)
         {
+            nodes++;
+
             if (base.expanded && (base.nodes.size() != 0))
             {
                 for (BoardTree &node : base.nodes)
                 {
-                    minimax(node);
+                    minimax(node, ply + 1);
                 }
 
                 if (base.board.get_turn() == Color::White)
                 {
-                    double eval = -1000000;
+                    Score eval = -infinite_score;
                     Move best;
 
                     for (const BoardTree &node : base.nodes)
@@ -55,7 +57,7 @@ public:
                 }
                 else
                 {
-                    double eval = 1000000;
+                    Score eval = infinite_score;
                     Move best;
 
                     for (const BoardTree &node : base.nodes)
@@ -79,7 +81,7 @@ public:
                 base.board.get_moves(movelist);
                 movelist.is_checkmate = base.is_checkmate;
                 movelist.is_stalemate = base.is_stalemate;
-                base.evaluation = base.board.adv_eval(movelist);
+                base.evaluation = cached_eval(threads[0], base.board, movelist, ply);
                 /*
                 if (movelist.is_stalemate)
                 {
@@ -109,17 +111,22 @@ public:
         std::uint64_t max_time = std::min(time_inc + time_left/4, std::uint64_t{30000});
         std::uint64_t exp_time = 0;
 
-        while ((max_time - time_spent > exp_time) && (ply <= 4))
+        while (
+                (depth_limit != 0) ?
+                (ply <= depth_limit) :
+                ((max_time - time_spent > exp_time) && (ply <= 4))
+              )
         {
             auto tp = std::chrono::high_resolution_clock::now();
             root.expand(movelist, z_list, ply);
-            minimax(root);
+            minimax(root, 0);
             std::chrono::duration<double> dur = std::chrono::high_resolution_clock::now() - tp;
 
             bestmove = root.bestmove;
             evaluation = root.evaluation*turn;
 
-            if (evaluation > 150)
+            // Stop once a forced mate is found
+            if (evaluation >= mate_bound)
             {
                 break;
             }
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <iterator>
@@ -5,7 +8,192 @@
 #include <string>
 #include <sstream>
 
+#include "BatchMovegen.hpp"
 #include "BoardTree.hpp"
+#include "DistributedPerft.hpp"
+#include "KoggeStone.hpp"
+
+// Perft where the boards one ply above the leaves are counted in batches
+void perft_batched(const Board &b, int d, BoardBatch &batch, std::uint64_t &total)
+{
+    if (d == 1)
+    {
+        batch.add(b);
+
+        if (batch.full())
+        {
+            batch.generate();
+            for (std::size_t i = 0; i < batch.size(); i++)
+                total += batch.move_count(i);
+            batch.clear();
+        }
+
+        return;
+    }
+
+    MoveList moves;
+    b.get_moves(moves);
+
+    for (const Move &m : moves)
+        perft_batched(Board(b, m), d-1, batch, total);
+}
+
+std::uint64_t perft_batched(const Board &b, int d)
+{
+    if (d == 0)
+        return 1;
+
+    static BoardBatch batch;
+    batch.clear();
+
+    std::uint64_t total = 0;
+    perft_batched(b, d, batch, total);
+
+    batch.generate();
+    for (std::size_t i = 0; i < batch.size(); i++)
+        total += batch.move_count(i);
+    batch.clear();
+
+    return total;
+}
+
+// Walks the perft tree and compares the incrementally updated evaluation sums
+// against ones recomputed from scratch
+void psqt_check(const Board &b, int d, std::uint64_t &positions, std::uint64_t &mismatches)
+{
+    Board fresh(b);
+    fresh.refresh_incremental();
+
+    positions++;
+    if (!fresh.incremental_equal(b))
+        mismatches++;
+
+    if (d == 0)
+        return;
+
+    MoveList moves;
+    b.get_moves(moves);
+
+    for (const Move &m : moves)
+        psqt_check(Board(b, m), d-1, positions, mismatches);
+}
+
+// Walks the perft tree and evaluates every position lazily against null
+// windows around it. Counts the lazy results and those on the other side of
+// the window from the full evaluation.
+void lazy_check(const Board &b, int d, std::uint64_t &lazy, std::uint64_t &crossed, Score &deviation)
+{
+    MoveList moves;
+    b.get_moves(moves);
+
+    const Score full = b.adv_eval(moves);
+
+    for (Score alpha = full - 1000; alpha <= full + 1000; alpha += 25)
+    {
+        bool exact;
+        const Score score = b.adv_eval_lazy(moves, 0, alpha, alpha + 1, nullptr, exact);
+
+        if (exact)
+            continue;
+
+        lazy++;
+        deviation = std::max(deviation, static_cast<Score>(std::abs(full - score)));
+
+        if ((score <= alpha) != (full <= alpha))
+            crossed++;
+    }
+
+    if (d == 0)
+        return;
+
+    for (const Move &m : moves)
+        lazy_check(Board(b, m), d-1, lazy, crossed, deviation);
+}
+
+// Walks the perft tree and compares see_ge against see for every move over a
+// range of thresholds
+void see_check(const Board &b, int d, std::uint64_t &checks, std::uint64_t &mismatches)
+{
+    static constexpr std::array<Score, 14> thresholds = {-20000, -900, -500, -400, -320, -100, -1, 0, 1, 100, 320, 500, 900, 20000};
+
+    MoveList moves;
+    b.get_moves(moves);
+
+    for (const Move &m : moves)
+    {
+        const Score see = b.see(m);
+
+        for (const Score threshold : thresholds)
+        {
+            checks++;
+            if (b.see_ge(m, threshold) != (see >= threshold))
+                mismatches++;
+        }
+
+        if (d > 1)
+            see_check(Board(b, m), d-1, checks, mismatches);
+    }
+}
+
+// Material and piece-square sums the way adv_eval used to find them, scanning
+// all 64 squares with get_tile. Kept as the reference for "perft evalscan".
+void psqt_scan(const Board &b, Score &mg, Score &eg, int &ph)
+{
+    mg = 0;
+    eg = 0;
+    ph = 0;
+
+    for (std::uint8_t x = 0; x < 8; x++)
+    {
+        for (std::uint8_t y = 0; y < 8; y++)
+        {
+            const Tile t = b.get_tile(x, y);
+
+            if (t.piece == Piece::None)
+                continue;
+
+            const std::uint8_t p = static_cast<std::uint8_t>(t.piece);
+            ph += eval_tables::phase_weights[p];
+
+            if (t.color == Color::White)
+            {
+                mg += eval_tables::psqt_mg[p][y*8+x];
+                eg += eval_tables::psqt_eg[p][y*8+x];
+            }
+            else
+            {
+                mg -= eval_tables::psqt_mg[p][(7-y)*8+x];
+                eg -= eval_tables::psqt_eg[p][(7-y)*8+x];
+            }
+        }
+    }
+}
+
+// Union of slider attacks the way the move generator does it, one ray
+// lookup and bitscan per piece and direction
+Bitboard ray_slider_attacks(Bitboard orth, Bitboard diag, Bitboard occ)
+{
+    Bitboard attacks = 0;
+
+    for (std::uint8_t d = 0; d < 8; d++)
+    {
+        Bitboard sliders = (d%2 == 0) ? diag : orth;
+
+        while (sliders)
+        {
+            const Square sq = bitboard_bitscan_forward_pop(sliders);
+            Bitboard ray = movegen_rays[d][sq];
+
+            const Bitboard blockers = ray & occ;
+            if (blockers != 0)
+                ray &= ~movegen_rays[d][bitboard_bitscan(blockers, d)];
+
+            attacks |= ray;
+        }
+    }
+
+    return attacks;
+}
 
 int main(int argc, char** argv)
 {
@@ -121,24 +309,334 @@ int main(int argc, char** argv)
         return 0;
     }
 
+    const auto named_position = [](const std::string &name)
+    {
+        if (name == "kiwipete")
+            return std::string("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -");
+        else if (name == "pos3")
+            return std::string("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -");
+        else if (name == "pos4")
+            return std::string("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq -");
+        else if (name == "pos5")
+            return std::string("rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ -");
+        else if (name == "pos6")
+            return std::string("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - -");
+
+        return std::string("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -");
+    };
+
+    // perft coordinator <depth> <position> <port> [split ply] [job timeout in seconds]
+    if (argc >= 5 && std::string(argv[1]) == "coordinator")
+    {
+        const int d = std::atoi(argv[2]);
+        const int split_ply = (argc > 5) ? std::atoi(argv[5]) : 3;
+        const int job_timeout = (argc > 6) ? std::max(std::atoi(argv[6]), 1) : 600;
+
+        Board base(named_position(argv[3]));
+        base.print();
+
+        PerftCoordinator coordinator(base, d, split_ply, job_timeout);
+
+        const auto ts = std::chrono::steady_clock::now();
+        const std::uint64_t total = coordinator.run(std::atoi(argv[4]));
+        const std::chrono::duration<double> dur = std::chrono::steady_clock::now() - ts;
+
+        std::cout << "Perft " << d << " = " << total << " (" << dur.count() << " s)" << std::endl;
+
+        return 0;
+    }
+
+    // perft worker <port> [host]
+    if (argc >= 3 && std::string(argv[1]) == "worker")
+    {
+        const std::string host = (argc > 3) ? argv[3] : "127.0.0.1";
+
+        PerftWorker worker;
+        const std::uint64_t completed = worker.run(host, std::atoi(argv[2]));
+
+        std::cout << "Worker completed " << completed << " jobs" << std::endl;
+
+        return 0;
+    }
+
     int goal = 6;
-    std::string pos = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -";
+    std::string pos = named_position("startpos");
 
     if (argc > 1)
         goal = std::atoi(argv[1]);
 
     if (argc > 2)
+        pos = named_position(argv[2]);
+
+    // Compare slider attack backends on positions from random games
+    if (argc == 2 && std::string(argv[1]) == "sliders")
     {
-        if (argv[2] == std::string("kiwipete"))
-            pos = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -";
-        else if (argv[2] == std::string("pos3"))
-            pos = "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -";
-        else if (argv[2] == std::string("pos4"))
-            pos = "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq -";
-        else if (argv[2] == std::string("pos5"))
-            pos = "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ -";
-        else if (argv[2] == std::string("pos6"))
-            pos = "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - -";
+        std::mt19937 rng(1337);
+        std::vector<std::array<Bitboard, 3>> sets; // Orthogonal, diagonal, occupancy
+
+        for (int game = 0; game < 200; game++)
+        {
+            Board b;
+            for (int ply = 0; ply < 80; ply++)
+            {
+                b.get_moves(moves);
+                if (moves.size() == 0)
+                    break;
+
+                for (Color c : {Color::White, Color::Black})
+                {
+                    const Bitboard queens = b.get_bitboard(c, Piece::Queen);
+                    sets.push_back({
+                            b.get_bitboard(c, Piece::Rook) | queens,
+                            b.get_bitboard(c, Piece::Bishop) | queens,
+                            ~b.get_bitboard(Color::Empty)});
+                }
+
+                b.perform_move(moves.at(rng() % moves.size()));
+            }
+        }
+
+        const auto time = [&](const std::string &name, Bitboard (*f)(Bitboard, Bitboard, Bitboard))
+        {
+            Bitboard check = 0;
+            const auto ts = std::chrono::steady_clock::now();
+
+            for (int rep = 0; rep < 100; rep++)
+                for (const auto &s : sets)
+                    check ^= f(s[0], s[1], s[2]);
+
+            const std::chrono::duration<double> dur = std::chrono::steady_clock::now() - ts;
+            std::cout << name << ": " << (sets.size()*100)/dur.count()/1e6 << " M sets/s (" << check << ")" << std::endl;
+        };
+
+        std::uint64_t mismatches = 0;
+        for (const auto &s : sets)
+        {
+            if (ray_slider_attacks(s[0], s[1], s[2]) != kogge_stone_attacks(s[0], s[1], s[2]))
+                mismatches++;
+        }
+        std::cout << sets.size() << " slider sets, " << mismatches << " mismatches" << std::endl;
+
+        time("Rays + bitscan     ", ray_slider_attacks);
+        time("Kogge-Stone scalar ", kogge_stone_attacks_scalar);
+#ifdef __AVX2__
+        time("Kogge-Stone AVX2   ", kogge_stone_attacks_avx2);
+#endif
+
+        return 0;
+    }
+
+    // Evaluations per second, adv_eval against the network. Without a
+    // network file a random one is used, the speed does not depend on it.
+    // perft evalbench [network file]
+    if (argc >= 2 && std::string(argv[1]) == "evalbench")
+    {
+        if (argc > 2)
+        {
+            if (!nnue::network.load(argv[2]))
+            {
+                std::cerr << "Could not load network " << argv[2] << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            nnue::network.randomize(1337);
+        }
+
+        nnue::enabled = true;
+
+        std::mt19937 rng(1337);
+        std::vector<Board> boards;
+
+        for (int game = 0; game < 200; game++)
+        {
+            Board b;
+            for (int ply = 0; ply < 80; ply++)
+            {
+                b.get_moves(moves);
+                if (moves.size() == 0)
+                    break;
+
+                boards.push_back(b);
+                b.perform_move(moves.at(rng() % moves.size()));
+            }
+        }
+
+        // Incremental accumulators against recomputed ones, and the AVX2
+        // kernel against the scalar one
+        std::uint64_t acc_mismatches = 0;
+        std::uint64_t eval_mismatches = 0;
+
+        for (const Board &b : boards)
+        {
+            Board fresh(b);
+            fresh.refresh_incremental();
+
+            if (!fresh.incremental_equal(b))
+                acc_mismatches++;
+
+            const nnue::AccumulatorPair &acc = b.get_accumulators();
+            if (nnue::evaluate_scalar(acc[0], acc[1]) != nnue::evaluate(acc[0], acc[1]))
+                eval_mismatches++;
+        }
+
+        std::cout << boards.size() << " positions, " << acc_mismatches << " accumulator mismatches, " <<
+            eval_mismatches << " scalar/vector mismatches" << std::endl;
+
+        const MoveList none;
+        PawnTable pawn_table;
+
+        const auto time = [&](const std::string &name, const auto &f)
+        {
+            std::int64_t check = 0;
+            const auto ts = std::chrono::steady_clock::now();
+
+            for (int rep = 0; rep < 20; rep++)
+                for (const Board &b : boards)
+                    check += f(b);
+
+            const std::chrono::duration<double> dur = std::chrono::steady_clock::now() - ts;
+            std::cout << name << ": " << (boards.size()*20)/dur.count()/1e6 << " M evals/s (" << check << ")" << std::endl;
+        };
+
+        time("adv_eval              ", [&](const Board &b) { return b.adv_eval(none); });
+        time("adv_eval + pawn table ", [&](const Board &b) { return b.adv_eval(none, 0, &pawn_table); });
+        time("NNUE scalar           ", [&](const Board &b) { return nnue::evaluate_scalar(b.get_accumulators()[0], b.get_accumulators()[1]); });
+#ifdef __AVX2__
+        time("NNUE AVX2             ", [&](const Board &b) { return nnue::evaluate_avx2(b.get_accumulators()[0], b.get_accumulators()[1]); });
+#endif
+
+        return 0;
+    }
+
+    // From scratch evaluation, get_tile scan against bitboards per piece type
+    // perft evalscan
+    if (argc == 2 && std::string(argv[1]) == "evalscan")
+    {
+        std::mt19937 rng(1337);
+        std::vector<Board> boards;
+
+        for (int game = 0; game < 200; game++)
+        {
+            Board b;
+            for (int ply = 0; ply < 80; ply++)
+            {
+                b.get_moves(moves);
+                if (moves.size() == 0)
+                    break;
+
+                boards.push_back(b);
+                b.perform_move(moves.at(rng() % moves.size()));
+            }
+        }
+
+        const MoveList none;
+        std::uint64_t mismatches = 0;
+
+        for (const Board &b : boards)
+        {
+            Score mg_scan, eg_scan, mg, eg;
+            int ph_scan, ph;
+            psqt_scan(b, mg_scan, eg_scan, ph_scan);
+            b.psqt_from_scratch(mg, eg, ph);
+
+            if (mg != mg_scan || eg != eg_scan || ph != ph_scan || b.adv_eval(none) != b.adv_eval_from_scratch(none))
+                mismatches++;
+        }
+
+        std::cout << boards.size() << " positions, " << mismatches << " mismatches" << std::endl;
+
+        const auto time = [&](const std::string &name, const auto &f)
+        {
+            std::int64_t check = 0;
+            const auto ts = std::chrono::steady_clock::now();
+
+            for (int rep = 0; rep < 20; rep++)
+                for (const Board &b : boards)
+                    check += f(b);
+
+            const std::chrono::duration<double> dur = std::chrono::steady_clock::now() - ts;
+            std::cout << name << ": " << (boards.size()*20)/dur.count()/1e6 << " M evals/s (" << check << ")" << std::endl;
+        };
+
+        time("Material + PST, get_tile scan ", [](const Board &b) { Score mg, eg; int ph; psqt_scan(b, mg, eg, ph); return mg + eg + ph; });
+        time("Material + PST, bitboards     ", [](const Board &b) { Score mg, eg; int ph; b.psqt_from_scratch(mg, eg, ph); return mg + eg + ph; });
+        time("adv_eval from scratch         ", [&](const Board &b) { return b.adv_eval_from_scratch(none); });
+        time("adv_eval incremental          ", [&](const Board &b) { return b.adv_eval(none); });
+
+        return 0;
+    }
+
+    // perft batch <depth> [position]
+    if (argc >= 3 && std::string(argv[1]) == "batch")
+    {
+        const int d = std::atoi(argv[2]);
+        Board base(named_position((argc > 3) ? argv[3] : "startpos"));
+        base.print();
+
+        for (int i = 1; i <= d; i++)
+        {
+            const auto ts = std::chrono::steady_clock::now();
+            const std::uint64_t n = perft_batched(base, i);
+            const std::chrono::duration<double> dur = std::chrono::steady_clock::now() - ts;
+
+            std::cout << "Perft " << i << " = " << n << " (" << dur.count() << " s)" << std::endl;
+        }
+
+        return 0;
+    }
+
+    // perft evalcheck <depth> [position]
+    if (argc >= 3 && std::string(argv[1]) == "evalcheck")
+    {
+        const int d = std::atoi(argv[2]);
+        Board base(named_position((argc > 3) ? argv[3] : "startpos"));
+        base.print();
+
+        std::uint64_t positions = 0;
+        std::uint64_t mismatches = 0;
+        psqt_check(base, d, positions, mismatches);
+
+        std::cout << positions << " positions, " << mismatches << " incremental evaluation mismatches" << std::endl;
+
+        return (mismatches == 0) ? 0 : 1;
+    }
+
+    // perft lazycheck <depth> [position]
+    if (argc >= 3 && std::string(argv[1]) == "lazycheck")
+    {
+        const int d = std::atoi(argv[2]);
+        Board base(named_position((argc > 3) ? argv[3] : "startpos"));
+        base.print();
+
+        std::uint64_t lazy = 0;
+        std::uint64_t crossed = 0;
+        Score deviation = 0;
+        lazy_check(base, d, lazy, crossed, deviation);
+
+        std::cout << lazy << " lazy evaluations, " << crossed << " on the wrong side of the window, largest error " << deviation << std::endl;
+
+        return 0;
+    }
+
+    // perft seecheck <depth> [position]
+    if (argc >= 3 && std::string(argv[1]) == "seecheck")
+    {
+        const int d = std::atoi(argv[2]);
+        Board base(named_position((argc > 3) ? argv[3] : "startpos"));
+        base.print();
+
+        std::uint64_t checks = 0;
+        std::uint64_t mismatches = 0;
+        see_check(base, d, checks, mismatches);
+
+        // A king recapturing onto a square that is still attacked
+        see_check(Board("2B5/Q5b1/p2p2q1/2Pbk3/7r/2K1P1p1/4P3/6R1 b - - 0 60"), 1, checks, mismatches);
+
+        std::cout << checks << " checks, " << mismatches << " static exchange mismatches" << std::endl;
+
+        return (mismatches == 0) ? 0 : 1;
     }
 
     Board base(pos);
@@ -15,6 +15,7 @@ public:
     {
         MoveList moves;
         board.get_moves(moves);
+        nodes++;
 
         if (moves.size() == 0)
         {
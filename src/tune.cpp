@@ -0,0 +1,554 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Board.hpp"
+
+// Texel tuning of the evaluation terms in evaluation.hpp.
+//
+// Every term that is tuned is linear in its parameter, so each position is
+// reduced once, at load time, to a short list of (parameter, coefficient)
+// features plus its phase and result. Evaluating a parameter vector is then a
+// dot product per position with no board and no allocation, split across
+// threads. The vector is fitted to the game results by minimising the mean
+// squared error of sigmoid(K*eval) with Adam.
+//
+// Usage: tune <epd file> [iterations] [output header] [threads]
+//
+// Each line holds a FEN and the game result, either as "1-0", "0-1" or
+// "1/2-1/2" anywhere on the line or as [1.0], [0.5] or [0.0].
+
+// Parameter layout. Material plus piece-square values have a middle and an
+// end game half, king zone attacks count in the middle game only and the
+// rest are not tapered.
+constexpr std::size_t psqt_size = 6*64;
+constexpr std::size_t mg_base = 0;
+constexpr std::size_t eg_base = mg_base + psqt_size;
+constexpr std::size_t bishop_pair_index = eg_base + psqt_size;
+constexpr std::size_t doubled_pawns_index = bishop_pair_index + 1;
+constexpr std::size_t isolated_pawn_index = doubled_pawns_index + 1;
+constexpr std::size_t passed_pawn_base = isolated_pawn_index + 1;
+constexpr std::size_t mobility_knight_index = passed_pawn_base + 8;
+constexpr std::size_t mobility_diagonal_index = mobility_knight_index + 1;
+constexpr std::size_t mobility_orthogonal_index = mobility_diagonal_index + 1;
+constexpr std::size_t king_zone_attack_index = mobility_orthogonal_index + 1;
+constexpr std::size_t param_count = king_zone_attack_index + 1;
+
+// A piece-square feature (index below psqt_size) stands for both its middle
+// and end game parameter
+struct Feature
+{
+    std::uint16_t index;
+    std::int16_t coefficient;
+};
+
+struct TuningPosition
+{
+    std::uint32_t first; // Into the feature array
+    std::uint16_t count;
+    std::uint8_t phase; // 0 to phase_max
+    std::uint8_t result; // Half points for white
+};
+
+std::vector<double> initial_params()
+{
+    using namespace eval_tables;
+
+    std::vector<double> w(param_count, 0.0);
+
+    for (std::size_t p = 0; p < 6; p++)
+    {
+        for (std::size_t sq = 0; sq < 64; sq++)
+        {
+            w[mg_base + p*64 + sq] = psqt_mg[p][sq];
+            w[eg_base + p*64 + sq] = psqt_eg[p][sq];
+        }
+    }
+
+    w[bishop_pair_index] = bishop_pair;
+    w[doubled_pawns_index] = doubled_pawns;
+    w[isolated_pawn_index] = isolated_pawn;
+
+    for (std::size_t r = 0; r < 8; r++)
+        w[passed_pawn_base + r] = passed_pawn[r];
+
+    w[mobility_knight_index] = mobility_knight;
+    w[mobility_diagonal_index] = mobility_diagonal;
+    w[mobility_orthogonal_index] = mobility_orthogonal;
+    w[king_zone_attack_index] = king_zone_attack;
+
+    return w;
+}
+
+class Dataset
+{
+public:
+    // Adds a line, false if it has no result or is not a position adv_eval
+    // scores linearly (terminal, or a known or scaled endgame)
+    bool add(const std::string &line)
+    {
+        std::uint8_t result;
+
+        if (line.find("1/2-1/2") != std::string::npos || line.find("[0.5]") != std::string::npos)
+            result = 1;
+        else if (line.find("1-0") != std::string::npos || line.find("[1.0]") != std::string::npos)
+            result = 2;
+        else if (line.find("0-1") != std::string::npos || line.find("[0.0]") != std::string::npos)
+            result = 0;
+        else
+            return false;
+
+        // Only the first four FEN fields, EPD operations may follow
+        std::istringstream iss(line);
+        std::string fen, token;
+
+        for (int i = 0; i < 4 && (iss >> token); i++)
+            fen += token + ' ';
+
+        const Board b(fen);
+
+        if (endgame::special(b.get_material_key()))
+            return false;
+
+        MoveList moves;
+        b.get_moves(moves);
+
+        if (moves.is_checkmate || moves.is_stalemate)
+            return false;
+
+        std::array<std::int32_t, param_count> coefficients = {0};
+        const int ph = extract(b, coefficients);
+
+        TuningPosition pos = {static_cast<std::uint32_t>(features.size()), 0, static_cast<std::uint8_t>(ph), result};
+
+        for (std::size_t i = 0; i < param_count; i++)
+        {
+            if (coefficients[i] == 0)
+                continue;
+
+            features.push_back({static_cast<std::uint16_t>(i), static_cast<std::int16_t>(coefficients[i])});
+            pos.count++;
+        }
+
+        positions.push_back(pos);
+
+        // The linear evaluation should agree with adv_eval up to rounding
+        const double diff = std::abs(evaluate(pos, reference.data()) - b.adv_eval(moves));
+        max_difference = std::max(max_difference, diff);
+
+        return true;
+    }
+
+    // From white's point of view, in centipawns
+    double evaluate(const TuningPosition &pos, const double *w) const
+    {
+        double mg = 0.0;
+        double eg = 0.0;
+        double flat = 0.0;
+
+        const Feature *f = &features[pos.first];
+        const Feature *end = f + pos.count;
+
+        for (; f != end; f++)
+        {
+            if (f->index < psqt_size)
+            {
+                mg += f->coefficient*w[mg_base + f->index];
+                eg += f->coefficient*w[eg_base + f->index];
+            }
+            else if (f->index == king_zone_attack_index)
+                mg += f->coefficient*w[f->index];
+            else
+                flat += f->coefficient*w[f->index];
+        }
+
+        return (mg*pos.phase + eg*(eval_tables::phase_max - pos.phase))/eval_tables::phase_max + flat;
+    }
+
+    // Mean squared error over positions [begin, end), and its gradient
+    // added into grad when given
+    double error(const double *w, double k, std::size_t begin, std::size_t end, double *grad) const
+    {
+        double sum = 0.0;
+        const double c = k*std::log(10.0)/400.0;
+
+        for (std::size_t i = begin; i < end; i++)
+        {
+            const TuningPosition &pos = positions[i];
+            const double s = sigmoid(k, evaluate(pos, w));
+            const double r = pos.result/2.0;
+
+            sum += (r - s)*(r - s);
+
+            if (grad == nullptr)
+                continue;
+
+            const double g = -2.0*(r - s)*s*(1.0 - s)*c;
+            const double mg_share = static_cast<double>(pos.phase)/eval_tables::phase_max;
+
+            const Feature *f = &features[pos.first];
+            const Feature *f_end = f + pos.count;
+
+            for (; f != f_end; f++)
+            {
+                const double gf = g*f->coefficient;
+
+                if (f->index < psqt_size)
+                {
+                    grad[mg_base + f->index] += gf*mg_share;
+                    grad[eg_base + f->index] += gf*(1.0 - mg_share);
+                }
+                else if (f->index == king_zone_attack_index)
+                    grad[f->index] += gf*mg_share;
+                else
+                    grad[f->index] += gf;
+            }
+        }
+
+        return sum;
+    }
+
+    static double sigmoid(double k, double eval)
+    {
+        return 1.0/(1.0 + std::pow(10.0, -k*eval/400.0));
+    }
+
+    std::size_t size() const
+    {
+        return positions.size();
+    }
+
+    std::size_t feature_count() const
+    {
+        return features.size();
+    }
+
+    double get_max_difference() const
+    {
+        return max_difference;
+    }
+
+private:
+    // Coefficients of the features of a position, the same terms as
+    // Board::adv_eval. Returns the clamped phase.
+    static int extract(const Board &b, std::array<std::int32_t, param_count> &coefficients)
+    {
+        using namespace eval_tables;
+
+        int ph = 0;
+
+        // Material and piece-square
+        for (std::uint8_t p = 0; p < 6; p++)
+        {
+            Bitboard white = b.get_bitboard(Color::White, static_cast<Piece>(p));
+            Bitboard black = b.get_bitboard(Color::Black, static_cast<Piece>(p));
+
+            ph += phase_weights[p]*bitboard_count(white | black);
+
+            while (white)
+                coefficients[p*64 + bitboard_bitscan_forward_pop(white)]++;
+
+            while (black)
+                coefficients[p*64 + (bitboard_bitscan_forward_pop(black) ^ 56)]--;
+        }
+
+        ph = std::min(ph, phase_max);
+
+        // Bishop pair, with two to four pieces including the king
+        for (Color c : {Color::White, Color::Black})
+        {
+            const int pieces = bitboard_count(b.get_bitboard(c) & ~b.get_bitboard(c, Piece::Pawn));
+
+            if (pieces >= 2 && pieces <= 4 && bitboard_count(b.get_bitboard(c, Piece::Bishop)) == 2)
+                coefficients[bishop_pair_index] += (c == Color::White) ? 1 : -1;
+        }
+
+        // Pawn structure, as in Board::evaluate_pawns
+        const Bitboard white_pawns = b.get_bitboard(Color::White, Piece::Pawn);
+        const Bitboard black_pawns = b.get_bitboard(Color::Black, Piece::Pawn);
+
+        for (std::uint8_t x = 0; x < 8; x++)
+        {
+            if (bitboard_count(white_pawns & (file_a << x)) >= 2)
+                coefficients[doubled_pawns_index]--;
+            if (bitboard_count(black_pawns & (file_a << x)) >= 2)
+                coefficients[doubled_pawns_index]++;
+        }
+
+        const auto neighbour_files = [](Bitboard pawns)
+        {
+            const Bitboard files = fill_north(fill_south(pawns));
+            return ((files << 1) & not_a) | ((files >> 1) & not_h);
+        };
+
+        coefficients[isolated_pawn_index] -= bitboard_count(white_pawns & ~neighbour_files(white_pawns));
+        coefficients[isolated_pawn_index] += bitboard_count(black_pawns & ~neighbour_files(black_pawns));
+
+        const PawnEntry pawns = b.evaluate_pawns();
+
+        Bitboard it = pawns.passed[0];
+        while (it)
+            coefficients[passed_pawn_base + bitboard_bitscan_forward_pop(it)/8]++;
+
+        it = pawns.passed[1];
+        while (it)
+            coefficients[passed_pawn_base + 7 - bitboard_bitscan_forward_pop(it)/8]--;
+
+        // Mobility and king zone attacks, as in Board::activity_eval
+        const std::array<std::array<Bitboard, 5>, 2> &attack_maps = b.get_attack_maps();
+
+        for (std::uint8_t c = 0; c < 2; c++)
+        {
+            const std::array<Bitboard, 5> &attacks = attack_maps[c];
+            const std::array<Bitboard, 5> &enemy_attacks = attack_maps[1-c];
+            const int sign = (c == 0) ? 1 : -1;
+
+            const Bitboard safe = ~b.get_bitboard(static_cast<Color>(c)) & ~enemy_attacks[0];
+            const Bitboard king_zone = b.get_bitboard(static_cast<Color>(1-c), Piece::King) | enemy_attacks[4];
+
+            coefficients[mobility_knight_index] += sign*bitboard_count(attacks[1] & safe);
+            coefficients[mobility_diagonal_index] += sign*bitboard_count(attacks[2] & safe);
+            coefficients[mobility_orthogonal_index] += sign*bitboard_count(attacks[3] & safe);
+            coefficients[king_zone_attack_index] += sign*bitboard_count((attacks[1] | attacks[2] | attacks[3]) & king_zone);
+        }
+
+        return ph;
+    }
+
+    std::vector<Feature> features;
+    std::vector<TuningPosition> positions;
+
+    const std::vector<double> reference = initial_params();
+    double max_difference = 0.0;
+};
+
+// Runs f(thread, begin, end) over the positions split evenly between threads
+template <typename F>
+void parallel_for(std::size_t n, std::size_t threads, F f)
+{
+    std::vector<std::thread> workers;
+
+    for (std::size_t t = 0; t < threads; t++)
+        workers.emplace_back(f, t, n*t/threads, n*(t+1)/threads);
+
+    for (std::thread &w : workers)
+        w.join();
+}
+
+double total_error(const Dataset &data, const std::vector<double> &w, double k, std::size_t threads)
+{
+    std::vector<double> partial(threads, 0.0);
+
+    parallel_for(data.size(), threads, [&](std::size_t t, std::size_t begin, std::size_t end)
+    {
+        partial[t] = data.error(w.data(), k, begin, end, nullptr);
+    });
+
+    double sum = 0.0;
+    for (double p : partial)
+        sum += p;
+
+    return sum/data.size();
+}
+
+// Scaling constant K that best fits the starting parameters, by narrowing
+// a scan around the best value
+double fit_k(const Dataset &data, const std::vector<double> &w, std::size_t threads)
+{
+    double best_k = 1.0;
+    double best = total_error(data, w, best_k, threads);
+    double step = 0.5;
+
+    for (int round = 0; round < 6; round++)
+    {
+        const double centre = best_k;
+
+        for (int i = -4; i <= 4; i++)
+        {
+            const double k = centre + i*step;
+
+            if (k <= 0.0)
+                continue;
+
+            const double e = total_error(data, w, k, threads);
+
+            if (e < best)
+            {
+                best = e;
+                best_k = k;
+            }
+        }
+
+        step /= 4;
+    }
+
+    return best_k;
+}
+
+void write_header(const std::string &path, const std::vector<double> &w, const std::string &source, std::size_t n, double err)
+{
+    std::ofstream f(path);
+
+    const auto value = [&](std::size_t i)
+    {
+        return std::to_string(static_cast<Score>(std::lround(w[i])));
+    };
+
+    const auto table = [&](const std::string &name, std::size_t base)
+    {
+        f << "    constexpr std::array<std::array<Score, 64>, 6> " << name << " =\n    {{\n";
+
+        for (std::size_t p = 0; p < 6; p++)
+        {
+            f << "        {";
+
+            for (std::size_t sq = 0; sq < 64; sq++)
+            {
+                f << ((sq%8 == 0) ? "\n            " : " ") << std::setw(5) << value(base + p*64 + sq);
+                if (sq != 63)
+                    f << ',';
+            }
+
+            f << "\n        }" << ((p != 5) ? "," : "") << "\n";
+        }
+
+        f << "    }};\n";
+    };
+
+    f << "#ifndef TUNED_EVAL_HPP\n#define TUNED_EVAL_HPP\n\n";
+    f << "// Written by tune from " << source << ", " << n << " positions, error " << err << "\n";
+    f << "// Tables are indexed by piece and board square (y*8+x) for white\n";
+    f << "namespace eval_tables\n{\n";
+    f << "    constexpr Score bishop_pair = " << value(bishop_pair_index) << ";\n";
+    f << "    constexpr Score doubled_pawns = " << value(doubled_pawns_index) << ";\n";
+    f << "    constexpr Score isolated_pawn = " << value(isolated_pawn_index) << ";\n\n";
+    f << "    constexpr Score mobility_knight = " << value(mobility_knight_index) << ";\n";
+    f << "    constexpr Score mobility_diagonal = " << value(mobility_diagonal_index) << ";\n";
+    f << "    constexpr Score mobility_orthogonal = " << value(mobility_orthogonal_index) << ";\n\n";
+    f << "    constexpr Score king_zone_attack = " << value(king_zone_attack_index) << ";\n\n";
+
+    f << "    constexpr std::array<Score, 8> passed_pawn = {";
+    for (std::size_t r = 0; r < 8; r++)
+        f << value(passed_pawn_base + r) << ((r != 7) ? ", " : "");
+    f << "};\n\n";
+
+    table("psqt_mg", mg_base);
+    f << "\n";
+    table("psqt_eg", eg_base);
+
+    f << "}\n\n#endif\n";
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: tune <epd file> [iterations] [output header] [threads]" << std::endl;
+        return 1;
+    }
+
+    const std::string path = argv[1];
+    const int iterations = (argc > 2) ? std::atoi(argv[2]) : 1000;
+    const std::string output = (argc > 3) ? argv[3] : "tuned_eval.hpp";
+    // At least one, a bad argument would otherwise split the work by zero
+    const std::size_t threads = (argc > 4) ? std::max(std::atoi(argv[4]), 1) : std::max(1u, std::thread::hardware_concurrency());
+
+    std::ifstream f(path);
+
+    if (!f)
+    {
+        std::cerr << "Could not open " << path << std::endl;
+        return 1;
+    }
+
+    Dataset data;
+    std::size_t skipped = 0;
+
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        std::string line;
+        while (std::getline(f, line))
+            if (!line.empty() && !data.add(line))
+                skipped++;
+
+        const double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Loaded " << data.size() << " positions (" << skipped << " skipped), "
+            << data.feature_count() << " features in " << s << " s" << std::endl;
+        std::cout << "Largest difference from adv_eval: " << data.get_max_difference() << " cp" << std::endl;
+    }
+
+    if (data.size() == 0)
+        return 1;
+
+    std::vector<double> w = initial_params();
+
+    const double k = fit_k(data, w, threads);
+    std::cout << "K = " << k << ", error " << total_error(data, w, k, threads) << std::endl;
+
+    // Adam, with per thread gradients summed after each pass
+    constexpr double rate = 1.0;
+    constexpr double beta1 = 0.9;
+    constexpr double beta2 = 0.999;
+    constexpr double epsilon = 1e-8;
+
+    std::vector<double> m(param_count, 0.0);
+    std::vector<double> v(param_count, 0.0);
+    std::vector<std::vector<double>> grads(threads, std::vector<double>(param_count));
+    std::vector<double> partial(threads);
+
+    for (int it = 1; it <= iterations; it++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        parallel_for(data.size(), threads, [&](std::size_t t, std::size_t begin, std::size_t end)
+        {
+            std::fill(grads[t].begin(), grads[t].end(), 0.0);
+            partial[t] = data.error(w.data(), k, begin, end, grads[t].data());
+        });
+
+        double err = 0.0;
+        for (double p : partial)
+            err += p;
+        err /= data.size();
+
+        for (std::size_t i = 0; i < param_count; i++)
+        {
+            double g = 0.0;
+            for (std::size_t t = 0; t < threads; t++)
+                g += grads[t][i];
+            g /= data.size();
+
+            m[i] = beta1*m[i] + (1.0 - beta1)*g;
+            v[i] = beta2*v[i] + (1.0 - beta2)*g*g;
+
+            const double m_hat = m[i]/(1.0 - std::pow(beta1, it));
+            const double v_hat = v[i]/(1.0 - std::pow(beta2, it));
+
+            w[i] -= rate*m_hat/(std::sqrt(v_hat) + epsilon);
+        }
+
+        const double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (it%10 == 0 || it == iterations)
+        {
+            std::cout << "Iteration " << it << ": error " << std::setprecision(8) << err
+                << ", " << std::setprecision(4) << data.size()/s/1e6 << " M positions/s" << std::endl;
+        }
+
+        if (it%100 == 0 || it == iterations)
+            write_header(output, w, path, data.size(), err);
+    }
+
+    std::cout << "Wrote " << output << std::endl;
+
+    return 0;
+}
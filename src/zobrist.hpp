@@ -11,7 +11,7 @@ std::uniform_int_distribution<std::uint64_t> zobrist_dist(0, std::numeric_limits
 
 // Zobrist values for pieces
 // INDEX IN ORDER OF COLOR (2), PIECE TYPE (6), SQUARE (64)
-const std::array<std::array<std::array<std::uint64_t, 64>, 6>, 2> zobrist_pieces = [&]()
+const std::array<std::array<std::array<std::uint64_t, 64>, 6>, 2> zobrist_pieces = []()
 {
     std::array<std::array<std::array<std::uint64_t, 64>, 6>, 2> z;
 
@@ -34,7 +34,7 @@ const std::uint64_t zobrist_black = zobrist_dist(zobrist_eng);
 
 // Four zobrist values for castling rights
 // INDEX IN ORDER OF WHITE/BLACK (2), KINGSIDE/QUEENSIDE (2)
-const std::array<std::array<std::uint64_t, 2>, 2> zobrist_castles = [&]()
+const std::array<std::array<std::uint64_t, 2>, 2> zobrist_castles = []()
 {
     std::array<std::array<std::uint64_t, 2>, 2> z;
 
@@ -50,7 +50,7 @@ const std::array<std::array<std::uint64_t, 2>, 2> zobrist_castles = [&]()
 }();
 
 // Zobrist values for en passant columns
-const std::array<std::uint64_t, 8> zobrist_ep = [&]()
+const std::array<std::uint64_t, 8> zobrist_ep = []()
 {
     std::array<std::uint64_t, 8> z;
 
@@ -0,0 +1,39 @@
+#!/bin/sh
+
+# Runs a distributed perft on localhost with four workers, one of which is
+# killed halfway so its job has to be re-queued.
+
+PERFT=../build/perft
+PORT=5555
+
+$PERFT coordinator 6 startpos $PORT 2 > /tmp/perft_coordinator.txt &
+COORDINATOR=$!
+sleep 1
+
+$PERFT worker $PORT &
+$PERFT worker $PORT &
+$PERFT worker $PORT &
+$PERFT worker $PORT &
+VICTIM=$!
+
+sleep 2
+kill -9 $VICTIM
+
+wait $COORDINATOR
+cat /tmp/perft_coordinator.txt
+
+if ! grep -q "Perft 6 = 119060324" /tmp/perft_coordinator.txt
+then
+    echo "Distributed perft FAILED"
+    exit 1
+fi
+
+# The result alone does not show the killed worker's job was re-queued, it
+# may have finished before the kill
+if ! grep -q "re-queueing job" /tmp/perft_coordinator.txt
+then
+    echo "Distributed perft FAILED, no job was re-queued"
+    exit 1
+fi
+
+echo "Distributed perft OK"